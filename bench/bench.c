@@ -0,0 +1,369 @@
+/******************************************************************************
+* bench.c - throughput benchmarks for the parser
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "../gps_parse.h"
+#include "../gps_dr.h"
+#include "../gps_geo.h"
+#include "../gps_merge.h"
+#include "nmea_gen.h"
+
+/*****************************************************************************
+* Each scenario is a generated stream, decoded repeatedly through
+* gps_parser_add_char() and gps_parser_add_bytes() with all the struct
+* callbacks set, so every sentence is fully decoded.
+*****************************************************************************/
+static volatile unsigned long sink;
+
+static void on_GGA(void *user, const gps_GGA_t *gga) { sink += gga->time_ms; }
+static void on_RMC(void *user, const gps_RMC_t *rmc) { sink += rmc->time_ms; }
+static void on_GLL(void *user, const gps_GLL_t *gll) { sink += gll->time_ms; }
+static void on_VTG(void *user, const gps_VTG_t *vtg) { sink += vtg->valid; }
+static void on_GSA(void *user, const gps_GSA_t *gsa) { sink += gsa->no_of_prns; }
+static void on_GSV(void *user, const gps_sky_t *sky) { sink += sky->count; }
+
+/*****************************************************************************/
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+static void setup(gps_parser_t *p) {
+  gps_parser_init(p, NULL);
+  gps_parser_GGA_callback_set(p, on_GGA);
+  gps_parser_RMC_callback_set(p, on_RMC);
+  gps_parser_GLL_callback_set(p, on_GLL);
+  gps_parser_VTG_callback_set(p, on_VTG);
+  gps_parser_GSA_callback_set(p, on_GSA);
+  gps_parser_GSV_callback_set(p, on_GSV);
+}
+
+/*****************************************************************************/
+static void run(const char *name, const char *data, size_t len, size_t lines,
+                int bulk, double min_time) {
+  gps_parser_t p;
+  double       start, elapsed;
+  unsigned     passes = 0;
+  size_t       i;
+
+  setup(&p);
+  start = now();
+  do {
+    if(bulk) {
+      gps_parser_add_bytes(&p, data, len);
+    } else {
+      for(i = 0; i < len; i++)
+        gps_parser_add_char(&p, (unsigned char)data[i]);
+    }
+    passes++;
+    elapsed = now() - start;
+  } while(elapsed < min_time);
+
+  printf("%-16s %-10s %10.1f %12.2f %12.1f\n", name, bulk ? "add_bytes" : "add_char",
+         (double)len * passes / elapsed / 1e6,
+         (double)lines * passes / elapsed / 1e6,
+         elapsed * 1e9 / ((double)lines * passes));
+}
+
+/*****************************************************************************/
+static void scenario(const char *name, const nmea_gen_config_t *cfg,
+                     char *data, size_t size, double min_time) {
+  size_t lines;
+  size_t len = nmea_gen(cfg, data, size, &lines);
+  if(len == 0 || lines == 0) return;
+  run(name, data, len, lines, 0, min_time);
+  run(name, data, len, lines, 1, min_time);
+}
+
+/*****************************************************************************/
+/* Dead reckoning queries, after feeding the engine the stream's fixes      */
+/*****************************************************************************/
+static void dr_queries(const char *name, int order, const char *data, size_t len, double min_time) {
+  gps_dr_position_t pos;
+  gps_parser_t      p;
+  gps_dr_t          dr;
+  double            start, elapsed, t;
+  unsigned long     queries = 0;
+  int               i;
+
+  gps_dr_init(&dr, order);
+  gps_parser_init(&p, &dr);
+  gps_parser_fix_callback_set(&p, gps_dr_fix_callback);
+  gps_parser_add_bytes(&p, data, len);
+  gps_parser_flush(&p);
+  if(dr.count == 0) return;
+
+  t     = dr.t0;
+  start = now();
+  do {
+    for(i = 0; i < 1000; i++) {
+      gps_dr_position_at(&dr, t + i * 1e-3, &pos);
+      sink += (unsigned long)pos.east;
+    }
+    queries += 1000;
+    elapsed = now() - start;
+  } while(elapsed < min_time);
+
+  printf("%-16s %-10s %10s %12.2f %12.1f\n", name, "query", "",
+         queries / elapsed / 1e6, elapsed * 1e9 / queries);
+}
+
+/*****************************************************************************/
+/* Merging three receivers' copies of the stream's fixes, each source with  */
+/* a different number of satellites so the choice moves around              */
+/*****************************************************************************/
+#define MERGE_FIXES 4096
+#define MERGE_SOURCES 3
+
+static gps_fix_t merge_in[MERGE_FIXES];
+static size_t    merge_count;
+
+static void collect_fix(void *user, const gps_fix_t *fix) {
+  if(merge_count < MERGE_FIXES && (fix->have & GPS_FIX_TIME))
+    merge_in[merge_count++] = *fix;
+}
+
+static void merged_fix(void *user, const gps_fix_t *fix) { sink += fix->time_ms; }
+
+static void merge_fixes(const char *name, const char *data, size_t len, double min_time) {
+  gps_parser_t  p;
+  gps_merge_t   m;
+  gps_fix_t     f;
+  double        start, elapsed;
+  unsigned long fixes = 0;
+  size_t        i;
+  unsigned      s;
+
+  gps_parser_init(&p, NULL);
+  gps_parser_fix_callback_set(&p, collect_fix);
+  merge_count = 0;
+  gps_parser_add_bytes(&p, data, len);
+  gps_parser_flush(&p);
+  if(merge_count == 0) return;
+
+  gps_merge_init(&m, MERGE_SOURCES, 1000, merged_fix, NULL);
+  start = now();
+  do {
+    for(i = 0; i < merge_count; i++) {
+      for(s = 0; s < MERGE_SOURCES; s++) {
+        f = merge_in[i];
+        f.no_of_sats += (i + s) % MERGE_SOURCES;
+        gps_merge_add(&m, s, &f);
+      }
+    }
+    gps_merge_flush(&m);
+    /* Start each pass afresh, as the times go round again */
+    gps_merge_init(&m, MERGE_SOURCES, 1000, merged_fix, NULL);
+    fixes  += merge_count * MERGE_SOURCES;
+    elapsed = now() - start;
+  } while(elapsed < min_time);
+
+  printf("%-16s %-10s %10s %12.2f %12.1f\n", name, "add", "",
+         fixes / elapsed / 1e6, elapsed * 1e9 / fixes);
+}
+
+/*****************************************************************************/
+/* Geodesy over columns of points, libm one point at a time against the    */
+/* polynomial loops in gps_geo                                              */
+/*****************************************************************************/
+#define GEO_POINTS 4096
+#define GEO_LIBM   2
+
+static void libm_ecef(const double *lat, const double *lon, const double *alt, size_t n,
+                      double *x, double *y, double *z) {
+  size_t i;
+  for(i = 0; i < n; i++) {
+    double sin_lat = sin(lat[i] * (M_PI / 180)), cos_lat = cos(lat[i] * (M_PI / 180));
+    double nr      = 6378137.0 / sqrt(1 - 6.69437999014e-3 * sin_lat * sin_lat);
+    x[i] = (nr + alt[i]) * cos_lat * cos(lon[i] * (M_PI / 180));
+    y[i] = (nr + alt[i]) * cos_lat * sin(lon[i] * (M_PI / 180));
+    z[i] = (nr * (1 - 6.69437999014e-3) + alt[i]) * sin_lat;
+  }
+}
+
+static void libm_distance(const double *lat, const double *lon, size_t n, double *distance) {
+  size_t i;
+  for(i = 0; i+1 < n; i++) {
+    double sin_dlat = sin((lat[i+1] - lat[i]) * (M_PI / 360));
+    double sin_dlon = sin((lon[i+1] - lon[i]) * (M_PI / 360));
+    double a = sin_dlat * sin_dlat
+             + cos(lat[i] * (M_PI / 180)) * cos(lat[i+1] * (M_PI / 180)) * sin_dlon * sin_dlon;
+    distance[i] = 2 * 6371008.8 * asin(sqrt(a));
+  }
+}
+
+static void geo_columns(const char *name, int distance, int mode, double min_time) {
+  static double   lat[GEO_POINTS], lon[GEO_POINTS], alt[GEO_POINTS];
+  static double   x[GEO_POINTS], y[GEO_POINTS], z[GEO_POINTS];
+  double          start, elapsed;
+  unsigned long   points = 0;
+  int             i;
+
+  /* A track wandering about Wellington */
+  srand(1);
+  for(i = 0; i < GEO_POINTS; i++) {
+    lat[i] = -41.29 + (rand() % 20000) * 1e-6;
+    lon[i] = 174.78 + (rand() % 20000) * 1e-6;
+    alt[i] = rand() % 100;
+  }
+
+  start = now();
+  do {
+    if(mode == GEO_LIBM && distance)  libm_distance(lat, lon, GEO_POINTS, x);
+    else if(mode == GEO_LIBM)         libm_ecef(lat, lon, alt, GEO_POINTS, x, y, z);
+    else if(distance)                 gps_geo_distance(lat, lon, GEO_POINTS, x, mode);
+    else                              gps_geo_ecef(lat, lon, alt, GEO_POINTS, x, y, z, mode);
+    sink   += (unsigned long)x[GEO_POINTS/2];
+    points += GEO_POINTS;
+    elapsed = now() - start;
+  } while(elapsed < min_time);
+
+  printf("%-16s %-10s %10s %12.2f %12.1f\n", name,
+         mode == GEO_LIBM ? "libm" : mode == GPS_GEO_FAST ? "fast" : "precise", "",
+         points / elapsed / 1e6, elapsed * 1e9 / points);
+}
+
+/*****************************************************************************/
+static void usage(void) {
+  fprintf(stderr, "Usage: bench [-n bytes] [-t seconds]\n"
+                  "       bench -g [-n bytes] [-S seed] [-T talkers] [-m GGA,RMC,GLL,VTG,GSA,GSV weights]\n"
+                  "                [-e checksum_error_rate] [-G garbage_rate] [-F no_fix_rate]\n"
+                  "                (write a corpus to stdout)\n");
+  exit(1);
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[]) {
+  static const char *type_names[NMEA_GEN_TYPES] = { "GGA", "RMC", "GLL", "VTG", "GSA", "GSV" };
+  nmea_gen_config_t cfg;
+  size_t            size     = 4u<<20;
+  double            min_time = 0.5;
+  int               generate = 0;
+  char             *data;
+  char              name[32];
+  size_t            len, lines;
+  int               opt, i;
+
+  nmea_gen_default(&cfg);
+  while((opt = getopt(argc, argv, "n:t:gS:T:m:e:G:F:")) != -1) {
+    switch(opt) {
+      case 'n': size     = strtoul(optarg, 0, 0);    break;
+      case 't': min_time = atof(optarg);             break;
+      case 'g': generate = 1;                        break;
+      case 'S': cfg.seed = strtoul(optarg, 0, 0);    break;
+      case 'T': cfg.talkers = optarg;                break;
+      case 'e': cfg.checksum_error_rate = atof(optarg); break;
+      case 'G': cfg.garbage_rate = atof(optarg);     break;
+      case 'F': cfg.no_fix_rate = atof(optarg);      break;
+      case 'm':
+        for(i = 0; i < NMEA_GEN_TYPES; i++) {
+          cfg.mix[i] = strtoul(optarg, &optarg, 10);
+          if(*optarg == ',') optarg++;
+        }
+        break;
+      default:  usage();
+    }
+  }
+
+  data = malloc(size);
+  if(data == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  if(generate) {
+    len = nmea_gen(&cfg, data, size, &lines);
+    fwrite(data, 1, len, stdout);
+    free(data);
+    return 0;
+  }
+
+  printf("%-16s %-10s %10s %12s %12s\n", "scenario", "path", "MB/s", "Msentences/s", "ns/sentence");
+
+  /* The usual mix of valid sentences */
+  nmea_gen_default(&cfg);
+  scenario("mixed", &cfg, data, size, min_time);
+
+  /* Each sentence decoder on its own */
+  for(i = 0; i < NMEA_GEN_TYPES; i++) {
+    nmea_gen_default(&cfg);
+    memset(cfg.mix, 0, sizeof(cfg.mix));
+    cfg.mix[i] = 1;
+    sprintf(name, "only-%s", type_names[i]);
+    scenario(name, &cfg, data, size, min_time);
+  }
+
+  /* Mixed constellations */
+  nmea_gen_default(&cfg);
+  cfg.talkers = "GP,GN,GL,GA,GB";
+  scenario("multi-talker", &cfg, data, size, min_time);
+
+  /* Every sentence fails its checksum */
+  nmea_gen_default(&cfg);
+  cfg.checksum_error_rate = 1.0;
+  scenario("checksum-fail", &cfg, data, size, min_time);
+
+  /* Half the lines are noise, so the parser keeps losing and finding sync */
+  nmea_gen_default(&cfg);
+  cfg.garbage_rate = 0.5;
+  scenario("garbage-resync", &cfg, data, size, min_time);
+
+  /* No fix anywhere, as in a long tunnel */
+  nmea_gen_default(&cfg);
+  cfg.no_fix_rate = 1.0;
+  scenario("no-fix", &cfg, data, size, min_time);
+
+  /* Position queries between fixes (Mqueries/s and ns/query) */
+  nmea_gen_default(&cfg);
+  len = nmea_gen(&cfg, data, size, &lines);
+  dr_queries("dr-linear", GPS_DR_LINEAR, data, len, min_time);
+  dr_queries("dr-cubic",  GPS_DR_CUBIC,  data, len, min_time);
+
+  /* Merging redundant receivers (Mfixes/s and ns/fix) */
+  merge_fixes("merge-3", data, len, min_time);
+
+  /* Geodesy on columns of points (Mpoints/s and ns/point) */
+  geo_columns("geo-ecef",     0, GEO_LIBM,        min_time);
+  geo_columns("geo-ecef",     0, GPS_GEO_PRECISE, min_time);
+  geo_columns("geo-ecef",     0, GPS_GEO_FAST,    min_time);
+  geo_columns("geo-distance", 1, GEO_LIBM,        min_time);
+  geo_columns("geo-distance", 1, GPS_GEO_PRECISE, min_time);
+  geo_columns("geo-distance", 1, GPS_GEO_FAST,    min_time);
+
+  free(data);
+  return sink == 0xFFFFFFFF;
+}
+/************************ End of file  ***************************************/
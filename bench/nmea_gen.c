@@ -0,0 +1,237 @@
+/******************************************************************************
+* nmea_gen.c - deterministic generator of synthetic NMEA streams
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "nmea_gen.h"
+
+struct gen {
+  const nmea_gen_config_t *cfg;
+  unsigned long long       state;
+  char                     talkers[16][3];
+  unsigned                 ntalkers;
+  unsigned                 total_mix;
+  unsigned                 second;
+};
+
+/****************************************************************************/
+/* xorshift64* - small, fast, and the same everywhere                       */
+/****************************************************************************/
+static unsigned long long next(struct gen *g) {
+  g->state ^= g->state >> 12;
+  g->state ^= g->state << 25;
+  g->state ^= g->state >> 27;
+  return g->state * 0x2545F4914F6CDD1Dull;
+}
+
+/****************************************************************************/
+static unsigned below(struct gen *g, unsigned n) {
+  return (unsigned)((next(g) >> 32) % n);
+}
+
+/****************************************************************************/
+static double chance(struct gen *g) {
+  return (next(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/****************************************************************************/
+static int gen_time(struct gen *g, char *out) {
+  unsigned t = g->second % 86400;
+  return sprintf(out, "%02u%02u%02u.%02u", t/3600, t/60%60, t%60, below(g, 100));
+}
+
+/****************************************************************************/
+static int gen_position(struct gen *g, char *out) {
+  return sprintf(out, "%02u%02u.%05u,%c,%03u%02u.%05u,%c",
+                 below(g, 90), below(g, 60), below(g, 100000), "NS"[below(g, 2)],
+                 below(g, 180), below(g, 60), below(g, 100000), "EW"[below(g, 2)]);
+}
+
+/****************************************************************************/
+static int gen_body(struct gen *g, enum nmea_gen_type type, char *out) {
+  char *p = out;
+  unsigned i;
+
+  p += sprintf(p, "%s", g->talkers[below(g, g->ntalkers)]);
+
+  /* What a receiver sends in a tunnel: the time and nothing else */
+  if(type <= NMEA_GEN_GLL && chance(g) < g->cfg->no_fix_rate) {
+    switch(type) {
+      case NMEA_GEN_GGA:
+        p += sprintf(p, "GGA,");
+        p += gen_time(g, p);
+        p += sprintf(p, ",,,,,0,00,99.99,,,,,,");
+        break;
+      case NMEA_GEN_RMC:
+        p += sprintf(p, "RMC,");
+        p += gen_time(g, p);
+        p += sprintf(p, ",V,,,,,,,%02u%02u%02u,,,N", 1+below(g, 28), 1+below(g, 12), below(g, 100));
+        break;
+      default:
+        p += sprintf(p, "GLL,,,,,");
+        p += gen_time(g, p);
+        p += sprintf(p, ",V,N");
+        break;
+    }
+    return p - out;
+  }
+
+  switch(type) {
+    case NMEA_GEN_GGA:
+      p += sprintf(p, "GGA,");
+      p += gen_time(g, p);
+      *p++ = ',';
+      p += gen_position(g, p);
+      p += sprintf(p, ",%u,%02u,%u.%u,%u.%u,M,%u.%u,M,,",
+                   1+below(g, 2), 4+below(g, 9), below(g, 5), below(g, 10),
+                   below(g, 3000), below(g, 10), below(g, 60), below(g, 10));
+      break;
+    case NMEA_GEN_RMC:
+      p += sprintf(p, "RMC,");
+      p += gen_time(g, p);
+      p += sprintf(p, ",A,");
+      p += gen_position(g, p);
+      p += sprintf(p, ",%u.%u,%u.%u,%02u%02u%02u,,",
+                   below(g, 100), below(g, 10), below(g, 360), below(g, 10),
+                   1+below(g, 28), 1+below(g, 12), below(g, 100));
+      break;
+    case NMEA_GEN_GLL:
+      p += sprintf(p, "GLL,");
+      p += gen_position(g, p);
+      *p++ = ',';
+      p += gen_time(g, p);
+      p += sprintf(p, ",A");
+      break;
+    case NMEA_GEN_VTG:
+      p += sprintf(p, "VTG,%u.%u,T,%u.%u,M,%u.%u,N,%u.%u,K",
+                   below(g, 360), below(g, 10), below(g, 360), below(g, 10),
+                   below(g, 100), below(g, 10), below(g, 185), below(g, 10));
+      break;
+    case NMEA_GEN_GSA:
+      p += sprintf(p, "GSA,A,3");
+      for(i = 0; i < 12; i++) {
+        if(below(g, 3) == 0) p += sprintf(p, ",");
+        else                 p += sprintf(p, ",%02u", 1+below(g, 32));
+      }
+      p += sprintf(p, ",%u.%u,%u.%u,%u.%u", below(g, 5), below(g, 10),
+                   below(g, 5), below(g, 10), below(g, 5), below(g, 10));
+      break;
+    case NMEA_GEN_GSV:
+      p += sprintf(p, "GSV,1,1,04");
+      for(i = 0; i < 4; i++)
+        p += sprintf(p, ",%02u,%02u,%03u,%02u", 1+below(g, 32), below(g, 90), below(g, 360), below(g, 60));
+      break;
+    default:
+      break;
+  }
+  return p - out;
+}
+
+/****************************************************************************/
+static int gen_line(struct gen *g, char *out) {
+  const nmea_gen_config_t *cfg = g->cfg;
+  unsigned pick, type, checksum = 0;
+  int      i, len;
+
+  /* Line noise: random bytes, no sentence in them */
+  if(chance(g) < cfg->garbage_rate) {
+    len = 10 + below(g, 60);
+    for(i = 0; i < len; i++) {
+      out[i] = (char)(1 + below(g, 255));
+      if(out[i] == '$') out[i] = '#';
+    }
+    out[len++] = '\n';
+    return len;
+  }
+
+  pick = below(g, g->total_mix);
+  for(type = 0; type < NMEA_GEN_TYPES-1; type++) {
+    if(pick < cfg->mix[type]) break;
+    pick -= cfg->mix[type];
+  }
+  if(type == NMEA_GEN_GGA) g->second++;
+
+  out[0] = '$';
+  len = 1 + gen_body(g, type, out+1);
+  for(i = 1; i < len; i++)
+    checksum ^= (unsigned char)out[i];
+  if(chance(g) < cfg->checksum_error_rate)
+    checksum ^= 1 + below(g, 255);
+  len += sprintf(out+len, "*%02X\r\n", checksum);
+  return len;
+}
+
+/****************************************************************************/
+void nmea_gen_default(nmea_gen_config_t *cfg) {
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->seed    = 1;
+  cfg->talkers = "GP";
+  cfg->mix[NMEA_GEN_GGA] = 1;
+  cfg->mix[NMEA_GEN_RMC] = 1;
+  cfg->mix[NMEA_GEN_GLL] = 1;
+  cfg->mix[NMEA_GEN_VTG] = 1;
+  cfg->mix[NMEA_GEN_GSA] = 1;
+  cfg->mix[NMEA_GEN_GSV] = 3;
+}
+
+/****************************************************************************/
+size_t nmea_gen(const nmea_gen_config_t *cfg, char *out, size_t size, size_t *lines) {
+  struct gen  g;
+  const char *t;
+  char        line[256];
+  size_t      used = 0;
+  unsigned    i;
+
+  memset(&g, 0, sizeof(g));
+  g.cfg   = cfg;
+  g.state = cfg->seed ? cfg->seed : 1;
+  for(i = 0; i < NMEA_GEN_TYPES; i++)
+    g.total_mix += cfg->mix[i];
+  if(g.total_mix == 0) return 0;
+
+  for(t = cfg->talkers; t[0] && t[1] && g.ntalkers < 16; t += 2) {
+    g.talkers[g.ntalkers][0] = t[0];
+    g.talkers[g.ntalkers][1] = t[1];
+    g.ntalkers++;
+    if(t[2] != ',') break;
+    t++;
+  }
+  if(g.ntalkers == 0) return 0;
+
+  *lines = 0;
+  for(;;) {
+    int len = gen_line(&g, line);
+    if(used + len > size) break;
+    memcpy(out+used, line, len);
+    used += len;
+    (*lines)++;
+  }
+  return used;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,60 @@
+/******************************************************************************
+* nmea_gen.h - deterministic generator of synthetic NMEA streams
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef NMEA_GEN_H
+#define NMEA_GEN_H
+#include <stddef.h>
+
+enum nmea_gen_type {
+  NMEA_GEN_GGA,
+  NMEA_GEN_RMC,
+  NMEA_GEN_GLL,
+  NMEA_GEN_VTG,
+  NMEA_GEN_GSA,
+  NMEA_GEN_GSV,
+  NMEA_GEN_TYPES
+};
+
+/* The same config always gives the same stream */
+typedef struct nmea_gen_config {
+  unsigned long seed;
+  unsigned      mix[NMEA_GEN_TYPES];  /* relative weight of each sentence type */
+  const char   *talkers;              /* comma separated, e.g. "GP,GN,GL" */
+  double        checksum_error_rate;  /* fraction of sentences with a bad checksum */
+  double        garbage_rate;         /* fraction of lines that are just noise */
+  double        no_fix_rate;          /* fraction of GGA, RMC and GLL without a fix */
+} nmea_gen_config_t;
+
+void nmea_gen_default(nmea_gen_config_t *cfg);
+
+/* Fills out with whole lines, up to size bytes. Returns the number of bytes
+   written, and the number of lines (good, bad or garbage) in *lines */
+size_t nmea_gen(const nmea_gen_config_t *cfg, char *out, size_t size, size_t *lines);
+#endif
+/************************ End of file  ***************************************/
@@ -0,0 +1,477 @@
+/******************************************************************************
+* decode.c - multithreaded NMEA log decoder
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../gps_parse.h"
+#include "../gps_bin.h"
+
+/*****************************************************************************
+* The log is memory mapped and cut into chunks at "\n$" boundaries. Each
+* chunk is decoded by its own parser, on whichever of a pool of worker
+* threads is free, into a text buffer.
+* An epoch can straddle a cut, so each worker holds back the head and the
+* last (unfinished) fix of its chunk, and the main thread stitches those
+* together as it writes the chunks out in order. The head is the first fix
+* with a time, and before it any untimed sentences (VTG, GSA) that followed
+* the cut, which the parser passes on as a fix of their own. Those are only
+* kept if the fix had not been lost before the cut, so the fix state at the
+* end of each chunk is carried over too. A chunk whose first status says
+* the fix is lost closes the epoch carried into it, as the parser would.
+*****************************************************************************/
+#define DEFAULT_CHUNK (8u<<20)
+
+static int binary;            /* -b: gps_bin records rather than CSV */
+
+struct text {
+  char   *data;
+  size_t  used;
+  size_t  size;
+};
+
+struct chunk {
+  const char *start;
+  size_t      len;
+  gps_fix_t   head[2];
+  int         heads;
+  gps_fix_t   last;           /* unfinished fix at the end of the chunk */
+  enum gps_fix_state state;   /* at the end, unknown if no status was seen */
+  int         acquired;       /* a status has said there is a fix */
+  int         lost;           /* the first status seen was no fix */
+  int         decoded;
+  struct text out;
+};
+
+/*****************************************************************************/
+/* Chunk n is cut into slot n % slots. The workers decode chunks in the     */
+/* order they were cut, and the main thread writes them out in that order,  */
+/* cutting the next one into each slot it has finished with. No worker      */
+/* waits for the others, and memory stays at slots * output per chunk.      */
+/*****************************************************************************/
+struct pool {
+  pthread_mutex_t lock;
+  pthread_cond_t  cut_cond;   /* a chunk has been cut, or there are no more */
+  pthread_cond_t  done_cond;  /* a chunk has been decoded */
+  struct chunk   *chunks;
+  long            slots;
+  unsigned long   cut;        /* chunks cut so far */
+  unsigned long   taken;      /* chunks taken by a worker */
+  int             finished;   /* no more chunks to cut */
+};
+
+/*****************************************************************************/
+static void text_reserve(struct text *t, size_t extra) {
+  if(t->used + extra <= t->size) return;
+  t->size = (t->size + extra) * 2;
+  t->data = realloc(t->data, t->size);
+  if(t->data == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+}
+
+/*****************************************************************************/
+/* Prints nanodegrees exactly, without going through a double               */
+/*****************************************************************************/
+static int print_ndeg(char *out, int64_t ndeg) {
+  const char *sign = "";
+  if(ndeg < 0) {
+    sign = "-";
+    ndeg = -ndeg;
+  }
+  return sprintf(out, "%s%lld.%09lld", sign, (long long)(ndeg / 1000000000), (long long)(ndeg % 1000000000));
+}
+
+/*****************************************************************************/
+static void write_csv(struct text *t, const gps_fix_t *f) {
+  char *out;
+
+  text_reserve(t, 256);
+  out = t->data + t->used;
+
+  /* Two digit years are 1980 to 2079, as the parser takes them */
+  if(f->have & GPS_FIX_DATE) {
+    unsigned yy = f->date%100;
+    out += sprintf(out, "%04u-%02u-%02u", yy < 80 ? 2000+yy : 1900+yy,
+                   f->date/100%100, f->date/10000);
+  }
+  *out++ = ',';
+  if(f->have & GPS_FIX_TIME)
+    out += sprintf(out, "%02u:%02u:%02u.%03u", f->time_ms/3600000, f->time_ms/60000%60,
+                   f->time_ms/1000%60, f->time_ms%1000);
+  *out++ = ',';
+  if(f->have & GPS_FIX_POSITION) {
+    out += print_ndeg(out, f->latitude_ndeg);
+    *out++ = ',';
+    out += print_ndeg(out, f->longitude_ndeg);
+  } else {
+    *out++ = ',';
+  }
+  *out++ = ',';
+  if(f->have & GPS_FIX_ALTITUDE)
+    out += sprintf(out, "%.3f", f->altitude);
+  *out++ = ',';
+  if(f->have & GPS_FIX_VELOCITY)
+    out += sprintf(out, "%.3f,%.2f", f->speed_knots, f->course);
+  else
+    *out++ = ',';
+  *out++ = ',';
+  if(f->have & GPS_FIX_QUALITY)
+    out += sprintf(out, "%u,%u,%.2f", f->fix_quality, f->no_of_sats, f->hor_dop);
+  else
+    out += sprintf(out, ",,");
+  *out++ = '\n';
+
+  t->used = out - t->data;
+}
+
+/*****************************************************************************/
+static void write_record(struct text *t, const gps_fix_t *f) {
+  gps_bin_record_t r;
+  gps_fix_t        fix;
+
+  if(!binary) {
+    write_csv(t, f);
+    return;
+  }
+  /* utc_ns isn't written, and a chunk only has it once its first date has
+     arrived, so the flag would depend on where the cuts fell */
+  fix       = *f;
+  fix.have &= ~GPS_FIX_UTC;
+  text_reserve(t, sizeof(r));
+  gps_bin_from_fix(&r, &fix);
+  gps_bin_encode((unsigned char *)t->data + t->used, &r);
+  t->used += sizeof(r);
+}
+
+/*****************************************************************************/
+/* Adds the groups of values that src has onto dest - both are parts of the */
+/* same epoch, decoded by neighbouring workers                              */
+/*****************************************************************************/
+static void merge_fix(gps_fix_t *dest, const gps_fix_t *src) {
+  if(src->have & GPS_FIX_TIME)
+    dest->time_ms = src->time_ms;
+  if(src->have & GPS_FIX_UTC)
+    dest->utc_ns = src->utc_ns;
+  if(src->have & GPS_FIX_POSITION) {
+    dest->latitude_ndeg  = src->latitude_ndeg;
+    dest->longitude_ndeg = src->longitude_ndeg;
+    dest->latitude       = src->latitude;
+    dest->longitude      = src->longitude;
+    memcpy(dest->talker, src->talker, sizeof(dest->talker));
+  }
+  if(src->have & GPS_FIX_ALTITUDE)
+    dest->altitude = src->altitude;
+  if(src->have & GPS_FIX_QUALITY) {
+    dest->fix_quality = src->fix_quality;
+    dest->no_of_sats  = src->no_of_sats;
+    dest->hor_dop     = src->hor_dop;
+  }
+  if(src->have & GPS_FIX_VELOCITY) {
+    dest->speed_knots = src->speed_knots;
+    dest->course      = src->course;
+  }
+  if(src->have & GPS_FIX_DATE)
+    dest->date = src->date;
+  if(src->have & GPS_FIX_DOP) {
+    dest->fix_type = src->fix_type;
+    dest->pos_dop  = src->pos_dop;
+    dest->hor_dop  = src->hor_dop;
+    dest->vert_dop = src->vert_dop;
+  }
+  dest->have |= src->have;
+}
+
+/*****************************************************************************/
+static void write_fix(FILE *out, const gps_fix_t *fix) {
+  struct text t = { NULL, 0, 0 };
+  write_record(&t, fix);
+  fwrite(t.data, 1, t.used, out);
+  free(t.data);
+}
+
+/*****************************************************************************/
+/* Joins a fix from the edge of a chunk onto the one carried over from the  */
+/* chunk before, when they are the same epoch. A fix with no time is only   */
+/* the untimed sentences that followed the cut. A closed fix is written.    */
+/*****************************************************************************/
+static void stitch(FILE *out, gps_fix_t *carry, const gps_fix_t *fix, int closed) {
+  if(carry->have && (!(fix->have & GPS_FIX_TIME)
+                     || ((carry->have & GPS_FIX_TIME) && fix->time_ms == carry->time_ms))) {
+    merge_fix(carry, fix);
+  } else {
+    if(carry->have)
+      write_fix(out, carry);
+    *carry = *fix;
+  }
+  if(closed) {
+    write_fix(out, carry);
+    carry->have = 0;
+  }
+}
+
+/*****************************************************************************/
+static void chunk_fix(void *user, const gps_fix_t *fix) {
+  struct chunk *c = user;
+  if(c->heads == 0 || (c->heads == 1 && !(c->head[0].have & GPS_FIX_TIME))) {
+    c->head[c->heads++] = *fix;
+    return;
+  }
+  write_record(&c->out, fix);
+}
+
+/*****************************************************************************/
+/* The parser starts with the fix state unknown, so these are called for    */
+/* the first status in the chunk whatever it is                             */
+/*****************************************************************************/
+static void chunk_no_fix(void *user) {
+  struct chunk *c = user;
+  if(!c->acquired && c->heads == 0)
+    c->lost = 1;
+}
+
+static void chunk_fix_acquired(void *user) {
+  struct chunk *c = user;
+  c->acquired = 1;
+}
+
+/*****************************************************************************/
+static void decode_chunk(struct chunk *c) {
+  gps_parser_t  parser;
+
+  gps_parser_init(&parser, c);
+  gps_parser_fix_callback_set(&parser, chunk_fix);
+  gps_parser_no_fix_callback_set(&parser, chunk_no_fix);
+  gps_parser_fix_acquired_callback_set(&parser, chunk_fix_acquired);
+
+  /* Each chunk starts on a '$', so prime the parser with a newline */
+  gps_parser_add_char(&parser, '\n');
+  gps_parser_add_bytes(&parser, c->start, c->len);
+  c->last  = parser.fix;
+  c->state = parser.fix_state;
+}
+
+/*****************************************************************************/
+static void *worker(void *arg) {
+  struct pool *pool = arg;
+
+  for(;;) {
+    struct chunk *c;
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->taken == pool->cut && !pool->finished)
+      pthread_cond_wait(&pool->cut_cond, &pool->lock);
+    if(pool->taken == pool->cut) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    c = &pool->chunks[pool->taken++ % pool->slots];
+    pthread_mutex_unlock(&pool->lock);
+
+    decode_chunk(c);
+
+    pthread_mutex_lock(&pool->lock);
+    c->decoded = 1;
+    pthread_cond_signal(&pool->done_cond);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+/*****************************************************************************/
+/* Find the next sentence start at or after pos                             */
+/*****************************************************************************/
+static size_t next_boundary(const char *data, size_t size, size_t pos) {
+  while(pos < size) {
+    const char *nl = memchr(data+pos, '\n', size-pos);
+    if(nl == NULL) return size;
+    pos = nl - data + 1;
+    if(pos < size && data[pos] == '$') return pos;
+  }
+  return size;
+}
+
+/*****************************************************************************/
+static void usage(void) {
+  fprintf(stderr, "Usage: decode [-t threads] [-c chunk_bytes] [-b] [-o output] input\n");
+  exit(1);
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[]) {
+  size_t            chunk_size = DEFAULT_CHUNK;
+  long              threads    = sysconf(_SC_NPROCESSORS_ONLN);
+  FILE             *out        = stdout;
+  gps_bin_writer_t  writer;
+  struct pool       pool;
+  pthread_t        *tids;
+  const char       *data;
+  struct stat       st;
+  size_t            pos;
+  gps_fix_t         carry;
+  enum gps_fix_state state = gps_fix_state_unknown;
+  unsigned long     next;
+  long              workers;
+  int               opt, fd;
+
+  while((opt = getopt(argc, argv, "t:c:o:b")) != -1) {
+    switch(opt) {
+      case 't': threads    = atol(optarg);          break;
+      case 'c': chunk_size = strtoul(optarg, 0, 0); break;
+      case 'b': binary     = 1;                     break;
+      case 'o':
+        out = fopen(optarg, "w");
+        if(out == NULL) {
+          printf("Unable to open output file\n");
+          return 1;
+        }
+        break;
+      default:  usage();
+    }
+  }
+  if(optind != argc-1 || threads < 1 || chunk_size < 1) usage();
+
+  /* Map the input */
+  fd = open(argv[optind], O_RDONLY);
+  if(fd < 0 || fstat(fd, &st) != 0) {
+    printf("Unable to open input file\n");
+    return 1;
+  }
+  if(st.st_size == 0) return 0;
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(data == MAP_FAILED) {
+    printf("Unable to map input file\n");
+    return 1;
+  }
+  madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+  memset(&pool, 0, sizeof(pool));
+  pool.slots  = threads * 2;
+  pool.chunks = calloc(pool.slots, sizeof(*pool.chunks));
+  tids        = calloc(threads, sizeof(*tids));
+  if(pool.chunks == NULL || tids == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.cut_cond, NULL);
+  pthread_cond_init(&pool.done_cond, NULL);
+
+  /* Carry on with fewer workers if not all of them can be started */
+  for(workers = 0; workers < threads; workers++)
+    if(pthread_create(&tids[workers], NULL, worker, &pool) != 0) break;
+  if(workers == 0) {
+    fprintf(stderr, "Unable to start a thread\n");
+    return 1;
+  }
+
+  if(binary)
+    gps_bin_writer_open(&writer, out);
+  else
+    fprintf(out, "date,time,latitude,longitude,altitude,speed_knots,course,fix_quality,no_of_sats,hor_dop\n");
+  memset(&carry, 0, sizeof(carry));
+
+  pos = next_boundary(data, st.st_size, 0);
+  if(data[0] == '$') pos = 0;
+  for(next = 0; ; next++) {
+    struct chunk *c;
+    int           h;
+
+    /* Cut chunks into every free slot, then wait for the next one due */
+    pthread_mutex_lock(&pool.lock);
+    while(pool.cut - next < (unsigned long)pool.slots && pos < (size_t)st.st_size) {
+      size_t end = next_boundary(data, st.st_size, pos + chunk_size);
+      c = &pool.chunks[pool.cut % pool.slots];
+      c->start    = data + pos;
+      c->len      = end - pos;
+      c->heads    = 0;
+      c->acquired = 0;
+      c->lost     = 0;
+      c->decoded  = 0;
+      c->out.used = 0;
+      pool.cut++;
+      pthread_cond_signal(&pool.cut_cond);
+      pos = end;
+    }
+    if(pos >= (size_t)st.st_size && !pool.finished) {
+      pool.finished = 1;
+      pthread_cond_broadcast(&pool.cut_cond);
+    }
+    if(next == pool.cut) {
+      pthread_mutex_unlock(&pool.lock);
+      break;
+    }
+    c = &pool.chunks[next % pool.slots];
+    while(!c->decoded)
+      pthread_cond_wait(&pool.done_cond, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+
+    /* Untimed sentences ahead of the first status in the chunk were sent
+       without a fix if it had been lost before the cut */
+    for(h = 0; h < c->heads; h++) {
+      int timed = (c->head[h].have & GPS_FIX_TIME) != 0;
+      if(timed && c->lost && carry.have) {
+        write_fix(out, &carry);
+        carry.have = 0;
+      }
+      if(timed || state != gps_fix_state_none)
+        stitch(out, &carry, &c->head[h], timed);
+    }
+    if(c->lost && carry.have) {
+      write_fix(out, &carry);
+      carry.have = 0;
+    }
+    if(c->out.used)
+      fwrite(c->out.data, 1, c->out.used, out);
+    if(c->last.have && ((c->last.have & GPS_FIX_TIME) || state != gps_fix_state_none))
+      stitch(out, &carry, &c->last, 0);
+    if(c->state != gps_fix_state_unknown)
+      state = c->state;
+  }
+
+  if(carry.have)
+    write_fix(out, &carry);
+
+  for(opt = 0; opt < workers; opt++)
+    pthread_join(tids[opt], NULL);
+  for(opt = 0; opt < pool.slots; opt++)
+    free(pool.chunks[opt].out.data);
+  free(pool.chunks);
+  free(tids);
+  munmap((void *)data, st.st_size);
+  close(fd);
+  if(out != stdout) fclose(out);
+  return 0;
+}
+/************************ End of file  ***************************************/
@@ -30,7 +30,7 @@
 #include <stdio.h>
 #include "../gps_parse.h"
 /*****************************************************************************/
-void test_GPGGA_callback( unsigned fix_quality, unsigned no_of_sats, double   timestamp,
+void test_GPGGA_callback(void *user, unsigned fix_quality, unsigned no_of_sats, double   timestamp,
        double   latitude, char     latitude_ns, double   longitude, char     longitude_ew,
        double   altitude, char     alt_units,   double   hor_dop)
 {
@@ -42,7 +42,7 @@ void test_GPGGA_callback( unsigned fix_quality, unsigned no_of_sats, double   ti
 }
 
 /*****************************************************************************/
-void test_GPRMC_callback( double timestamp,   double   date_of_fix, char   nav_warning,
+void test_GPRMC_callback(void *user, double timestamp,   double   date_of_fix, char   nav_warning,
     double   latitude,    char   latitude_ns, double   longitude,   char   longitude_ew, 
     double   speed_knots, double course)
 {
@@ -55,19 +55,19 @@ void test_GPRMC_callback( double timestamp,   double   date_of_fix, char   nav_w
 }
 
 /*****************************************************************************/
-void test_GPVTG_callback(double value, char unit) {
+void test_GPVTG_callback(void *user, double value, char unit) {
     printf("valid GPVTG: %10.6f %c\n", value, unit);
 }
 
 /*****************************************************************************/
-void test_reject_callback(char *message, char *buffer) {
+void test_reject_callback(void *user, char *message, char *buffer) {
   if(buffer) 
     printf("Rejected %s: '%s'\n",message,buffer);
   else
     printf("Rejected %s\n",message);
 }
 /*****************************************************************************/
-void test_GPGLL_callback( double   timestamp, 
+void test_GPGLL_callback(void *user, double   timestamp, 
 		          double   latitude,  char     latitude_ns,
 	                  double   longitude, char     longitude_ew) {
     printf("Valid GPGLL fix %f: %f %c, %f %c\n", timestamp,
@@ -76,13 +76,17 @@ void test_GPGLL_callback( double   timestamp,
 }
 /*****************************************************************************/
 int main(int argc, char *argv[]) {
-  int c;
-  /* Set the callbacks */
-  gps_GPGGA_callback_set(test_GPGGA_callback);
-  gps_GPRMC_callback_set(test_GPRMC_callback);
-  gps_GPVTG_callback_set(test_GPVTG_callback);
-  gps_GPGLL_callback_set(test_GPGLL_callback);
-  gps_reject_callback_set(test_reject_callback);
+  char buffer[4096];
+  size_t len;
+  gps_parser_t parser;
+
+  /* Set up the parser and its callbacks */
+  gps_parser_init(&parser, NULL);
+  gps_parser_GPGGA_callback_set(&parser, test_GPGGA_callback);
+  gps_parser_GPRMC_callback_set(&parser, test_GPRMC_callback);
+  gps_parser_GPVTG_callback_set(&parser, test_GPVTG_callback);
+  gps_parser_GPGLL_callback_set(&parser, test_GPGLL_callback);
+  gps_parser_reject_callback_set(&parser, test_reject_callback);
 
   /* Open the file */
   FILE *f = fopen(argv[1], "r");
@@ -92,10 +96,9 @@ int main(int argc, char *argv[]) {
   }
 
   /* Process the contents of the file */
-  c = getc(f);
-  while(c != EOF) {
-     gps_add_char(c);
-     c = getc(f);
+  while((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+     gps_parser_add_bytes(&parser, buffer, len);
   }
+  fclose(f);
 }
 /************************ End of file  ***************************************/
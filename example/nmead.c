@@ -0,0 +1,485 @@
+/******************************************************************************
+* example/nmead.c - epoll based multi-receiver NMEA daemon
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include "../gps_parse.h"
+
+/*****************************************************************************
+* One thread and one epoll set serve every receiver. Each receiver fd has
+* its own parser, reads go into one large buffer that is handed straight to
+* gps_parser_add_bytes(), and each fix is published as a line of text to
+* every client of a Unix stream socket. A slow client is dropped rather
+* than ever blocking the loop.
+*
+* Sources:  -u port    UDP datagrams, a parser per sender address (the one
+*                      heard from longest ago makes way after MAX_SENDERS)
+*           -t port    TCP, a parser per connection
+*           -p         a pseudo-terminal, whose name is printed
+*           -l file    loopback stand-in: the file is replayed through a
+*                      pipe at -r bytes/sec, round and round
+*****************************************************************************/
+#define READ_SIZE      (64u<<10)
+#define MAX_EVENTS     64
+#define TICKS_PER_SEC  100
+#define MAX_SENDERS    32       /* per UDP port */
+
+enum kind {
+  K_UDP, K_TCP_LISTEN, K_TCP, K_PTY, K_LOOP, K_LOOP_TIMER, K_PUB_LISTEN, K_SUBSCRIBER
+};
+
+/* Where fixes come from: a parser, and the name they are published under */
+struct source {
+  char             name[48];
+  gps_parser_t     parser;
+  unsigned long    fixes;
+};
+
+/* Datagrams from different receivers on one port must not meet in one
+   parser's epoch, so each sender address gets its own */
+struct sender {
+  struct sockaddr_in addr;
+  unsigned long    heard;     /* when last heard from, to pick one to drop */
+  struct source    source;
+};
+
+struct endpoint {
+  enum kind        kind;
+  int              fd;
+  struct source    source;    /* parser used by the kinds that carry NMEA */
+  int              hold_fd;   /* K_PTY: our own open of the slave side */
+  struct sender   *senders;   /* K_UDP */
+  unsigned         senders_used;
+  unsigned long    datagrams;
+  int              dead;      /* removed, but events for it may be in hand */
+  struct endpoint *next;
+};
+
+static int              epfd;
+static struct endpoint *endpoints;
+static struct endpoint *graveyard;    /* freed once the events in hand are done */
+static char             read_buffer[READ_SIZE];
+static volatile sig_atomic_t stopping;
+
+/* Loopback replay */
+static char   *loop_data;
+static size_t  loop_len, loop_pos, loop_per_tick = 4800/TICKS_PER_SEC;
+static int     loop_write_fd = -1;
+
+/*****************************************************************************/
+static void fail(const char *what) {
+  perror(what);
+  exit(1);
+}
+
+/*****************************************************************************/
+static void nonblocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/*****************************************************************************/
+static void publish(void *user, const gps_fix_t *f);
+
+/*****************************************************************************/
+static int carries_nmea(enum kind kind) {
+  return kind == K_TCP || kind == K_PTY || kind == K_LOOP;
+}
+
+/*****************************************************************************/
+static void source_init(struct source *s, const char *name) {
+  snprintf(s->name, sizeof(s->name), "%s", name);
+  gps_parser_init(&s->parser, s);
+  gps_parser_fix_callback_set(&s->parser, publish);
+  /* A datagram or a new connection starts on a '$', so don't lose it
+     waiting for a newline first */
+  gps_parser_add_char(&s->parser, '\n');
+}
+
+/*****************************************************************************/
+static struct endpoint *add_endpoint(enum kind kind, int fd, const char *name) {
+  struct epoll_event ev;
+  struct endpoint *e = calloc(1, sizeof(*e));
+  if(e == NULL) fail("calloc");
+
+  e->kind    = kind;
+  e->fd      = fd;
+  e->hold_fd = -1;
+  if(carries_nmea(kind))
+    source_init(&e->source, name);
+  else
+    snprintf(e->source.name, sizeof(e->source.name), "%s", name);
+  if(kind == K_UDP) {
+    e->senders = calloc(MAX_SENDERS, sizeof(*e->senders));
+    if(e->senders == NULL) fail("calloc");
+  }
+  e->next   = endpoints;
+  endpoints = e;
+
+  nonblocking(fd);
+  ev.events   = EPOLLIN;
+  ev.data.ptr = e;
+  if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) fail("epoll_ctl");
+  return e;
+}
+
+/*****************************************************************************/
+/* An endpoint can be removed while events for it are still waiting later   */
+/* in the same batch (a subscriber dropped by publish(), say), so it is     */
+/* closed now but only freed by bury() after the batch                      */
+/*****************************************************************************/
+static void remove_endpoint(struct endpoint *e) {
+  struct endpoint **p;
+  unsigned          i;
+
+  for(p = &endpoints; *p; p = &(*p)->next) {
+    if(*p == e) {
+      *p = e->next;
+      break;
+    }
+  }
+  if(carries_nmea(e->kind))
+    fprintf(stderr, "%s closed, %lu fixes\n", e->source.name, e->source.fixes);
+  for(i = 0; i < e->senders_used; i++)
+    fprintf(stderr, "%s closed, %lu fixes\n", e->senders[i].source.name, e->senders[i].source.fixes);
+  epoll_ctl(epfd, EPOLL_CTL_DEL, e->fd, NULL);
+  close(e->fd);
+  if(e->hold_fd >= 0)
+    close(e->hold_fd);
+  e->fd     = -1;
+  e->dead   = 1;
+  e->next   = graveyard;
+  graveyard = e;
+}
+
+/*****************************************************************************/
+static void bury(void) {
+  while(graveyard) {
+    struct endpoint *e = graveyard;
+    graveyard = e->next;
+    free(e->senders);
+    free(e);
+  }
+}
+
+/*****************************************************************************/
+/* One line per fix, to every subscriber                                    */
+/*****************************************************************************/
+static void publish(void *user, const gps_fix_t *f) {
+  struct source   *source = user;
+  struct endpoint *e, *next;
+  char line[256];
+  int  len;
+
+  source->fixes++;
+  if(!(f->have & GPS_FIX_POSITION)) return;
+
+  len = snprintf(line, sizeof(line), "%s,%06u,%09u,%.9f,%.9f,%.3f,%.3f,%.2f,%u,%u,%.2f\n",
+                 source->name, f->date, f->time_ms, f->latitude, f->longitude,
+                 f->altitude, f->speed_knots, f->course, f->fix_quality, f->no_of_sats, f->hor_dop);
+
+  for(e = endpoints; e; e = next) {
+    next = e->next;
+    if(e->kind != K_SUBSCRIBER) continue;
+    if(send(e->fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len)
+      remove_endpoint(e);
+  }
+}
+
+/*****************************************************************************/
+static int listen_socket(int type, int port) {
+  struct sockaddr_in addr;
+  int one = 1;
+  int fd  = socket(AF_INET, type, 0);
+
+  if(fd < 0) fail("socket");
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(port);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) fail("bind");
+  if(type == SOCK_STREAM && listen(fd, 64) != 0) fail("listen");
+  return fd;
+}
+
+/*****************************************************************************/
+/* While nothing has the slave side open the master reads EIO and polls as  */
+/* hung up, level triggered, so the loop would spin. Holding the slave open */
+/* ourselves keeps it quiet between writers                                 */
+/*****************************************************************************/
+static void open_pty(void) {
+  struct termios raw;
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  int slave;
+
+  if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) fail("posix_openpt");
+  tcgetattr(master, &raw);
+  cfmakeraw(&raw);
+  tcsetattr(master, TCSANOW, &raw);
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if(slave < 0) fail(ptsname(master));
+  fprintf(stderr, "pty source on %s\n", ptsname(master));
+  add_endpoint(K_PTY, master, "pty")->hold_fd = slave;
+}
+
+/*****************************************************************************/
+static void open_loop(const char *path) {
+  struct itimerspec tick;
+  FILE *f = fopen(path, "rb");
+  int   fds[2], timer;
+
+  if(f == NULL) fail(path);
+  fseek(f, 0, SEEK_END);
+  loop_len = ftell(f);
+  rewind(f);
+  loop_data = malloc(loop_len);
+  if(loop_data == NULL || fread(loop_data, 1, loop_len, f) != loop_len || loop_len == 0)
+    fail(path);
+  fclose(f);
+
+  if(pipe(fds) != 0) fail("pipe");
+  loop_write_fd = fds[1];
+  nonblocking(loop_write_fd);
+  add_endpoint(K_LOOP, fds[0], "loop");
+
+  timer = timerfd_create(CLOCK_MONOTONIC, 0);
+  if(timer < 0) fail("timerfd_create");
+  tick.it_interval.tv_sec  = 0;
+  tick.it_interval.tv_nsec = 1000000000/TICKS_PER_SEC;
+  tick.it_value            = tick.it_interval;
+  timerfd_settime(timer, 0, &tick, NULL);
+  add_endpoint(K_LOOP_TIMER, timer, "loop timer");
+}
+
+/*****************************************************************************/
+static void loop_tick(struct endpoint *e) {
+  uint64_t expirations;
+  size_t   todo;
+
+  if(read(e->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+  todo = loop_per_tick * expirations;
+  while(todo > 0) {
+    size_t  piece = loop_len - loop_pos;
+    ssize_t n;
+    if(piece > todo) piece = todo;
+    n = write(loop_write_fd, loop_data + loop_pos, piece);
+    if(n <= 0) break;           /* pipe full, catch up next tick */
+    todo    -= n;
+    loop_pos = (loop_pos + n) % loop_len;
+  }
+}
+
+/*****************************************************************************/
+static void open_publisher(const char *path) {
+  struct sockaddr_un addr;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if(fd < 0) fail("socket");
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  unlink(path);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) fail(path);
+  if(listen(fd, 16) != 0) fail("listen");
+  add_endpoint(K_PUB_LISTEN, fd, "publisher");
+}
+
+/*****************************************************************************/
+/* The parser for a datagram's sender. A new sender takes a free slot, or   */
+/* the one heard from longest ago, whose fix in progress is flushed first   */
+/*****************************************************************************/
+static struct source *udp_source(struct endpoint *e, const struct sockaddr_in *from) {
+  struct sender *s, *oldest = NULL;
+  char           name[48];
+  unsigned       i;
+
+  e->datagrams++;
+  for(i = 0; i < e->senders_used; i++) {
+    s = &e->senders[i];
+    if(s->addr.sin_addr.s_addr == from->sin_addr.s_addr && s->addr.sin_port == from->sin_port) {
+      s->heard = e->datagrams;
+      return &s->source;
+    }
+    if(oldest == NULL || s->heard < oldest->heard)
+      oldest = s;
+  }
+
+  if(e->senders_used < MAX_SENDERS) {
+    s = &e->senders[e->senders_used++];
+  } else {
+    s = oldest;
+    gps_parser_flush(&s->source.parser);
+    fprintf(stderr, "%s dropped, %lu fixes\n", s->source.name, s->source.fixes);
+  }
+  s->addr  = *from;
+  s->heard = e->datagrams;
+  snprintf(name, sizeof(name), "%.16s/%s:%u", e->source.name,
+           inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+  memset(&s->source, 0, sizeof(s->source));
+  source_init(&s->source, name);
+  fprintf(stderr, "%s new sender\n", name);
+  return &s->source;
+}
+
+/*****************************************************************************/
+static void readable(struct endpoint *e) {
+  struct sockaddr_in from;
+  socklen_t          from_len;
+  char    name[32];
+  ssize_t n;
+  int     fd;
+
+  switch(e->kind) {
+    case K_TCP_LISTEN:
+      while((fd = accept(e->fd, NULL, NULL)) >= 0) {
+        snprintf(name, sizeof(name), "tcp%d", fd);
+        add_endpoint(K_TCP, fd, name);
+      }
+      return;
+
+    case K_PUB_LISTEN:
+      while((fd = accept(e->fd, NULL, NULL)) >= 0)
+        add_endpoint(K_SUBSCRIBER, fd, "subscriber");
+      return;
+
+    case K_LOOP_TIMER:
+      loop_tick(e);
+      return;
+
+    case K_UDP:
+      /* An error reading the port isn't worth closing it over */
+      for(;;) {
+        from_len = sizeof(from);
+        n = recvfrom(e->fd, read_buffer, sizeof(read_buffer), 0, (struct sockaddr *)&from, &from_len);
+        if(n < 0) return;
+        if(n > 0)
+          gps_parser_add_bytes(&udp_source(e, &from)->parser, read_buffer, n);
+      }
+
+    case K_SUBSCRIBER:
+      /* Anything a subscriber sends is ignored, until it hangs up */
+      n = read(e->fd, read_buffer, sizeof(read_buffer));
+      if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        remove_endpoint(e);
+      return;
+
+    default:
+      /* Drain everything that is waiting, a buffer at a time */
+      for(;;) {
+        n = read(e->fd, read_buffer, sizeof(read_buffer));
+        if(n > 0) {
+          gps_parser_add_bytes(&e->source.parser, read_buffer, n);
+          continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        /* Closed or failed, and would only poll ready again */
+        gps_parser_flush(&e->source.parser);
+        remove_endpoint(e);
+        return;
+      }
+  }
+}
+
+/*****************************************************************************/
+static void on_signal(int sig) {
+  stopping = 1;
+}
+
+/*****************************************************************************/
+static void usage(void) {
+  fprintf(stderr, "Usage: nmead [-u udp_port] [-t tcp_port] [-p] [-l file [-r bytes_per_sec]]\n"
+                  "             [-s socket_path]\n");
+  exit(1);
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[]) {
+  struct epoll_event events[MAX_EVENTS];
+  const char *socket_path = "/tmp/nmead.sock";
+  const char *loop_file   = NULL;
+  char        name[32];
+  int         opt, n, i;
+
+  epfd = epoll_create1(0);
+  if(epfd < 0) fail("epoll_create1");
+
+  while((opt = getopt(argc, argv, "u:t:pl:r:s:")) != -1) {
+    switch(opt) {
+      case 'u':
+        snprintf(name, sizeof(name), "udp%s", optarg);
+        add_endpoint(K_UDP, listen_socket(SOCK_DGRAM, atoi(optarg)), name);
+        break;
+      case 't':
+        add_endpoint(K_TCP_LISTEN, listen_socket(SOCK_STREAM, atoi(optarg)), "tcp listener");
+        break;
+      case 'p': open_pty();                                      break;
+      case 'l': loop_file     = optarg;                          break;
+      case 'r': loop_per_tick = strtoul(optarg, 0, 0) / TICKS_PER_SEC + 1; break;
+      case 's': socket_path   = optarg;                          break;
+      default:  usage();
+    }
+  }
+  if(optind != argc || (endpoints == NULL && loop_file == NULL)) usage();
+  if(loop_file) open_loop(loop_file);
+  open_publisher(socket_path);
+
+  signal(SIGINT,  on_signal);
+  signal(SIGTERM, on_signal);
+
+  while(!stopping) {
+    n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+    if(n < 0 && errno != EINTR) fail("epoll_wait");
+    for(i = 0; i < n; i++) {
+      struct endpoint *e = events[i].data.ptr;
+      if(!e->dead)
+        readable(e);
+    }
+    bury();
+  }
+
+  while(endpoints)
+    remove_endpoint(endpoints);
+  bury();
+  unlink(socket_path);
+  return 0;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,249 @@
+/******************************************************************************
+* example/ring.c - reader / decoder threads joined by gps_ring queues
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <termios.h>
+#include <pthread.h>
+#include "../gps_parse.h"
+#include "../gps_ring.h"
+
+/*****************************************************************************
+* Drives the gps_ring queues the way a receiver would: one thread feeds a
+* file into a pipe (or a pseudo-terminal with -p), a reader thread copies
+* whatever arrives into a byte ring, a decoder thread parses out of the
+* ring into a fix queue, and the main thread takes the fixes. The fixes are
+* checked against decoding the file directly.
+*****************************************************************************/
+#define RING_SIZE  (1u<<16)
+#define QUEUE_SIZE 4096
+
+static char            *input;
+static size_t           input_len;
+static int              write_fd, read_fd;
+
+static char             ring_data[RING_SIZE];
+static gps_byte_ring_t  ring;
+static gps_fix_t        queue_data[QUEUE_SIZE];
+static gps_fix_queue_t  queue;
+static atomic_int       reader_done, decoder_done;
+
+/*****************************************************************************/
+static void *feeder(void *arg) {
+  size_t pos = 0, piece = 1;
+
+  /* Odd sized writes, so sentences arrive split up */
+  while(pos < input_len) {
+    ssize_t n;
+    piece = piece * 7 % 1021 + 1;
+    if(piece > input_len - pos) piece = input_len - pos;
+    n = write(write_fd, input + pos, piece);
+    if(n <= 0) break;
+    pos += n;
+  }
+  return NULL;
+}
+
+/*****************************************************************************/
+static void *reader(void *arg) {
+  static char buffer[4096];
+  size_t total = 0;
+
+  /* A pty doesn't see end of file, so stop after the whole input */
+  while(total < input_len) {
+    ssize_t n = read(read_fd, buffer, sizeof(buffer));
+    size_t  done = 0;
+    if(n <= 0) break;
+    total += n;
+    while(done < (size_t)n) {
+      size_t put = gps_byte_ring_write(&ring, buffer + done, n - done);
+      if(put == 0) sched_yield();
+      done += put;
+    }
+  }
+  atomic_store(&reader_done, 1);
+  return NULL;
+}
+
+/*****************************************************************************/
+static void *decoder(void *arg) {
+  gps_parser_t parser;
+
+  gps_parser_init(&parser, &queue);
+  gps_parser_fix_callback_set(&parser, gps_fix_queue_callback);
+
+  for(;;) {
+    int         done = atomic_load(&reader_done);
+    size_t      len;
+    const char *data = gps_byte_ring_peek(&ring, &len);
+
+    if(len == 0) {
+      if(done) break;
+      sched_yield();
+      continue;
+    }
+    gps_parser_add_bytes(&parser, data, len);
+    gps_byte_ring_consume(&ring, len);
+  }
+  gps_parser_flush(&parser);
+  atomic_store(&decoder_done, 1);
+  return NULL;
+}
+
+struct fix_list {
+  gps_fix_t *fix;
+  size_t     count;
+  size_t     size;
+};
+
+/*****************************************************************************/
+static void expect_fix(void *user, const gps_fix_t *fix) {
+  struct fix_list *list = user;
+  if(list->count == list->size) {
+    list->size = list->size * 2 + 64;
+    list->fix  = realloc(list->fix, list->size * sizeof(gps_fix_t));
+    if(list->fix == NULL) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  list->fix[list->count++] = *fix;
+}
+
+/*****************************************************************************/
+static int same_fix(const gps_fix_t *a, const gps_fix_t *b) {
+  return a->have == b->have && a->time_ms == b->time_ms && a->date == b->date
+      && a->latitude_ndeg == b->latitude_ndeg && a->longitude_ndeg == b->longitude_ndeg;
+}
+
+/*****************************************************************************/
+static int open_pty(void) {
+  struct termios raw;
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+  if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return 0;
+  read_fd = open(ptsname(master), O_RDONLY | O_NOCTTY);
+  if(read_fd < 0) return 0;
+
+  /* No line discipline - the bytes must arrive as they were sent */
+  tcgetattr(read_fd, &raw);
+  cfmakeraw(&raw);
+  tcsetattr(read_fd, TCSANOW, &raw);
+  write_fd = master;
+  return 1;
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[]) {
+  struct fix_list expected = { NULL, 0, 0 };
+  gps_parser_t    parser;
+  gps_fix_t       fix;
+  pthread_t       tids[3];
+  size_t          received = 0, wrong = 0;
+  FILE           *f;
+  int             use_pty = 0, fds[2], i;
+
+  if(argc == 3 && strcmp(argv[1], "-p") == 0) {
+    use_pty = 1;
+    argv++;
+    argc--;
+  }
+  if(argc != 2) {
+    fprintf(stderr, "Usage: ring [-p] input.nmea\n");
+    return 1;
+  }
+
+  /* Read the input, and decode it directly for the expected fixes */
+  f = fopen(argv[1], "rb");
+  if(f == NULL) {
+    printf("Unable to open input file\n");
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  input_len = ftell(f);
+  rewind(f);
+  input = malloc(input_len + 1);
+  if(input == NULL || fread(input, 1, input_len, f) != input_len) {
+    printf("Unable to read input file\n");
+    return 1;
+  }
+  fclose(f);
+
+  gps_parser_init(&parser, &expected);
+  gps_parser_fix_callback_set(&parser, expect_fix);
+  gps_parser_add_bytes(&parser, input, input_len);
+  gps_parser_flush(&parser);
+
+  if(use_pty) {
+    if(!open_pty()) {
+      printf("Unable to open a pseudo-terminal\n");
+      return 1;
+    }
+  } else {
+    if(pipe(fds) != 0) {
+      printf("Unable to open a pipe\n");
+      return 1;
+    }
+    read_fd  = fds[0];
+    write_fd = fds[1];
+  }
+
+  gps_byte_ring_init(&ring, ring_data, sizeof(ring_data));
+  gps_fix_queue_init(&queue, queue_data, QUEUE_SIZE);
+  pthread_create(&tids[0], NULL, decoder, NULL);
+  pthread_create(&tids[1], NULL, reader,  NULL);
+  pthread_create(&tids[2], NULL, feeder,  NULL);
+
+  /* Take fixes until the decoder has finished and the queue is empty */
+  for(;;) {
+    int done = atomic_load(&decoder_done);
+    if(gps_fix_queue_pop(&queue, &fix)) {
+      if(received >= expected.count || !same_fix(&fix, &expected.fix[received]))
+        wrong++;
+      received++;
+    } else if(done) {
+      break;
+    } else {
+      sched_yield();
+    }
+  }
+
+  for(i = 0; i < 3; i++)
+    pthread_join(tids[i], NULL);
+
+  printf("%s: %zu bytes, %zu fixes expected, %zu received, %lu dropped, %zu wrong\n",
+         use_pty ? "pty" : "pipe", input_len, expected.count, received, queue.dropped, wrong);
+  return (received == expected.count && wrong == 0) ? 0 : 1;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,218 @@
+/******************************************************************************
+* fuzz.c - fuzz harness for the parser
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "../gps_parse.h"
+
+/*****************************************************************************
+* Every input is decoded twice, once a byte at a time through
+* gps_parser_add_char() and once in chunks through gps_parser_add_bytes(),
+* with every callback set so that all of the decoding code runs. The two
+* must agree on what they accepted and rejected. Build with
+* -fsanitize=address,undefined (make fuzz does) so that any read past a
+* field or overflow stops the run.
+*
+* With -DGPS_FUZZ_LIBFUZZER this is just LLVMFuzzerTestOneInput() for
+* clang -fsanitize=fuzzer. Otherwise main() runs each file or directory
+* named on the command line, or stdin when there are none (for AFL).
+*****************************************************************************/
+static volatile unsigned long sink;
+
+static void on_reject(void *user, char *message, char *buffer) {
+  sink += strlen(message);
+  if(buffer != NULL) sink += strlen(buffer);
+}
+static void on_GPGGA(void *user, unsigned fix_quality, unsigned no_of_sats, double timestamp,
+                     double latitude, char latitude_ns, double longitude, char longitude_ew,
+                     double altitude, char alt_units, double hor_dop) {
+  sink += fix_quality + no_of_sats + (unsigned long)timestamp + latitude_ns + alt_units;
+}
+static void on_GPRMC(void *user, double timestamp, double date_of_fix, char nav_warning,
+                     double latitude, char latitude_ns, double longitude, char longitude_ew,
+                     double speed_knots, double course) {
+  sink += (unsigned long)date_of_fix + nav_warning;
+}
+static void on_GPVTG(void *user, double value, char unit) { sink += unit; }
+static void on_GPGLL(void *user, double timestamp, double latitude, char latitude_ns,
+                     double longitude, char longitude_ew) {
+  sink += latitude_ns + longitude_ew;
+}
+static void on_GGA(void *user, const gps_GGA_t *gga) { sink += gga->time_ms; }
+static void on_RMC(void *user, const gps_RMC_t *rmc) { sink += rmc->date; }
+static void on_GLL(void *user, const gps_GLL_t *gll) { sink += gll->time_ms; }
+static void on_VTG(void *user, const gps_VTG_t *vtg) { sink += vtg->valid; }
+static void on_GSA(void *user, const gps_GSA_t *gsa) { sink += gsa->no_of_prns; }
+static void on_GSV(void *user, const gps_sky_t *sky) { sink += sky->count; }
+static void on_fix(void *user, const gps_fix_t *fix) { sink += fix->have + fix->utc_ns; }
+static void on_ubx(void *user, const gps_ubx_t *frame) { sink += frame->length; }
+static void on_PVT(void *user, const gps_NAV_PVT_t *pvt) { sink += pvt->itow; }
+static void on_no_fix(void *user) { sink += 1; }
+static void on_fix_acquired(void *user) { sink += 2; }
+
+/*****************************************************************************/
+/* Reads every field every way it can be read                               */
+/*****************************************************************************/
+static void on_view(void *user, const gps_sentence_t *s) {
+  unsigned i;
+
+  for(i = 0; i <= s->fields; i++) {
+    unsigned len, u;
+    int64_t  n;
+    double   d;
+    int      places;
+    char     c;
+
+    if(gps_field(s, i, &len) != NULL) sink += len;
+    sink += gps_field_present(s, i);
+    if(gps_field_char(s, i, &c, "AVNSEW")) sink += c;
+    if(gps_field_uint(s, i, &u)) sink += u;
+    if(gps_field_double(s, i, &d)) sink += (unsigned long)(d != 0);
+    if(gps_field_number(s, i, &n, &places)) sink += places;
+    if(gps_field_scaled(s, i, 3, &n, &d)) sink += (unsigned long)n;
+    if(gps_field_angle(s, i, &d)) sink += (unsigned long)(d != 0);
+    if(gps_field_position(s, i, &n, &d)) sink += (unsigned long)n;
+    if(gps_field_time(s, i, &u, &d)) sink += u;
+  }
+}
+
+/*****************************************************************************/
+static void setup(gps_parser_t *p, unsigned options, char *buffer) {
+  int type;
+
+  gps_parser_init(p, NULL);
+  if(options & 1)
+    gps_parser_charset_set(p, GPS_CHARSET_LENIENT);
+  if(options & 2)
+    gps_parser_buffer_set(p, buffer, options & 4 ? GPS_MIN_BUFFER_SIZE : 512);
+  gps_parser_reject_callback_set(p, on_reject);
+  gps_parser_no_fix_callback_set(p, on_no_fix);
+  gps_parser_fix_acquired_callback_set(p, on_fix_acquired);
+  gps_parser_GPGGA_callback_set(p, on_GPGGA);
+  gps_parser_GPRMC_callback_set(p, on_GPRMC);
+  gps_parser_GPVTG_callback_set(p, on_GPVTG);
+  gps_parser_GPGLL_callback_set(p, on_GPGLL);
+  gps_parser_GGA_callback_set(p, on_GGA);
+  gps_parser_RMC_callback_set(p, on_RMC);
+  gps_parser_GLL_callback_set(p, on_GLL);
+  gps_parser_VTG_callback_set(p, on_VTG);
+  gps_parser_GSA_callback_set(p, on_GSA);
+  gps_parser_GSV_callback_set(p, on_GSV);
+  gps_parser_fix_callback_set(p, on_fix);
+  gps_parser_ubx_callback_set(p, on_ubx);
+  gps_parser_NAV_PVT_callback_set(p, on_PVT);
+  for(type = 0; type < GPS_SENTENCE_OTHER; type++)
+    gps_parser_view_callback_set(p, (enum gps_sentence_type)type, on_view);
+  gps_parser_timing_set(p, 1);
+}
+
+/*****************************************************************************/
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t len) {
+  static gps_parser_t by_char, by_bytes;
+  static char         char_buffer[512], bytes_buffer[512];
+  gps_stats_t a, b;
+  size_t      i, chunk;
+  unsigned    options;
+
+  /* The first byte picks the character set, buffer size and chunk size,
+     so all of them get covered over the corpus */
+  options = len > 0 ? data[0] : 0;
+  setup(&by_char,  options, char_buffer);
+  setup(&by_bytes, options, bytes_buffer);
+
+  for(i = 0; i < len; i++)
+    gps_parser_add_char(&by_char, data[i]);
+  gps_parser_flush(&by_char);
+
+  chunk = options / 8 + 1;
+  for(i = 0; i < len; i += chunk)
+    gps_parser_add_bytes_at(&by_bytes, (const char *)data + i, len-i < chunk ? len-i : chunk, i);
+  gps_parser_flush(&by_bytes);
+
+  gps_parser_stats(&by_char,  &a);
+  gps_parser_stats(&by_bytes, &b);
+  if(a.bytes != b.bytes || a.skipped != b.skipped || a.resyncs != b.resyncs
+     || a.max_sentence_length != b.max_sentence_length
+     || memcmp(a.accepted, b.accepted, sizeof(a.accepted)) != 0
+     || memcmp(a.rejected, b.rejected, sizeof(a.rejected)) != 0) {
+    fprintf(stderr, "add_char() and add_bytes() disagree\n");
+    abort();
+  }
+  return 0;
+}
+
+#ifndef GPS_FUZZ_LIBFUZZER
+/*****************************************************************************/
+static int run_file(const char *name) {
+  static unsigned char data[1<<20];
+  size_t len;
+  FILE  *f = strcmp(name, "-") == 0 ? stdin : fopen(name, "rb");
+
+  if(f == NULL) {
+    fprintf(stderr, "Unable to open %s\n", name);
+    return 0;
+  }
+  len = fread(data, 1, sizeof(data), f);
+  if(f != stdin) fclose(f);
+  LLVMFuzzerTestOneInput(data, len);
+  return 1;
+}
+
+/*****************************************************************************/
+static int run_path(const char *name) {
+  DIR           *dir = opendir(name);
+  struct dirent *e;
+  char           path[4096];
+  int            count = 0;
+
+  if(dir == NULL) return run_file(name);
+  while((e = readdir(dir)) != NULL) {
+    if(e->d_name[0] == '.') continue;
+    snprintf(path, sizeof(path), "%s/%s", name, e->d_name);
+    count += run_file(path);
+  }
+  closedir(dir);
+  return count;
+}
+
+/*****************************************************************************/
+int main(int argc, char *argv[]) {
+  int i, count = 0;
+
+  if(argc < 2)
+    count = run_file("-");
+  for(i = 1; i < argc; i++)
+    count += run_path(argv[i]);
+  printf("%d inputs decoded\n", count);
+  return 0;
+}
+#endif
+/************************ End of file  ***************************************/
@@ -0,0 +1,72 @@
+/******************************************************************************
+* gps_batch.c - columnar output of decoded fixes
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <string.h>
+#include "gps_batch.h"
+
+/****************************************************************************/
+void gps_batch_init(gps_batch_t *batch, size_t capacity) {
+  memset(batch, 0, sizeof(*batch));
+  batch->capacity = capacity;
+}
+
+/****************************************************************************/
+int gps_batch_add(gps_batch_t *batch, const gps_fix_t *fix) {
+  size_t n = batch->count;
+
+  if(n == batch->capacity) {
+    batch->overflow++;
+    return 0;
+  }
+
+  if(batch->have)           batch->have[n]           = fix->have;
+  if(batch->time_ms)        batch->time_ms[n]        = fix->time_ms;
+  if(batch->utc_ns)         batch->utc_ns[n]         = fix->utc_ns;
+  if(batch->rx_ns)          batch->rx_ns[n]          = fix->rx_ns;
+  if(batch->date)           batch->date[n]           = fix->date;
+  if(batch->latitude)       batch->latitude[n]       = fix->latitude;
+  if(batch->longitude)      batch->longitude[n]      = fix->longitude;
+  if(batch->latitude_ndeg)  batch->latitude_ndeg[n]  = fix->latitude_ndeg;
+  if(batch->longitude_ndeg) batch->longitude_ndeg[n] = fix->longitude_ndeg;
+  if(batch->altitude)       batch->altitude[n]       = fix->altitude;
+  if(batch->speed_knots)    batch->speed_knots[n]    = fix->speed_knots;
+  if(batch->course)         batch->course[n]         = fix->course;
+  if(batch->hor_dop)        batch->hor_dop[n]        = fix->hor_dop;
+  if(batch->fix_quality)    batch->fix_quality[n]    = fix->fix_quality;
+  if(batch->no_of_sats)     batch->no_of_sats[n]     = fix->no_of_sats;
+
+  batch->count = n+1;
+  return 1;
+}
+
+/****************************************************************************/
+void gps_parser_batch_set(gps_parser_t *p, gps_batch_t *batch) {
+  p->batch = batch;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,79 @@
+/******************************************************************************
+* gps_batch.h - columnar output of decoded fixes
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef GPS_BATCH_H
+#define GPS_BATCH_H
+#include "gps_parse.h"
+
+/****************************************************************************
+* A batch is a set of caller supplied column arrays, each with room for
+* capacity fixes. Fix n is written to element n of every column that is not
+* NULL, so set up only the columns you want. Nothing is allocated.
+****************************************************************************/
+typedef struct gps_batch {
+  size_t    capacity;
+  size_t    count;
+  size_t    overflow;         /* fixes dropped because the batch was full */
+
+  unsigned *have;             /* GPS_FIX_* bits */
+  unsigned *time_ms;
+  int64_t  *utc_ns;
+  int64_t  *rx_ns;
+  unsigned *date;
+  double   *latitude;
+  double   *longitude;
+  int64_t  *latitude_ndeg;
+  int64_t  *longitude_ndeg;
+  double   *altitude;
+  double   *speed_knots;
+  double   *course;
+  double   *hor_dop;
+  unsigned *fix_quality;
+  unsigned *no_of_sats;
+} gps_batch_t;
+
+/* Clears all the columns, ready for them to be set */
+void gps_batch_init(gps_batch_t *batch, size_t capacity);
+
+/* Appends a fix, returning 0 (and counting it in overflow) if the batch is
+   already full */
+int  gps_batch_add(gps_batch_t *batch, const gps_fix_t *fix);
+
+/****************************************************************************
+* Batch mode - the parser's epoch aggregator writes each fix into the batch.
+* When it fills, gps_parser_add_bytes() returns early with the number of
+* bytes it used. Empty the batch (set count back to 0) and call again with
+* the rest. gps_parser_add_char() can't return early, so check count after
+* each character. At the end of the input, gps_parser_flush() adds the last
+* fix if there is room. Fixes that arrive while the batch is full are
+* dropped and counted in overflow. Pass NULL to leave batch mode.
+****************************************************************************/
+void gps_parser_batch_set(gps_parser_t *p, gps_batch_t *batch);
+#endif
+/************************ End of file  ***************************************/
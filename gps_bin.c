@@ -0,0 +1,289 @@
+/******************************************************************************
+* gps_bin.c - compact binary fix records
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gps_bin.h"
+
+/* The reader casts the mapped file straight to records */
+typedef char gps_bin_record_size_check[sizeof(gps_bin_record_t) == 32 ? 1 : -1];
+typedef char gps_bin_header_size_check[sizeof(gps_bin_header_t) == 16 ? 1 : -1];
+
+/****************************************************************************/
+static int little_endian(void) {
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+/****************************************************************************/
+static void put16(unsigned char *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+/****************************************************************************/
+static void put32(unsigned char *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+/****************************************************************************/
+static int32_t to_e7(int64_t ndeg) {
+  return (int32_t)((ndeg + (ndeg < 0 ? -50 : 50)) / 100);
+}
+
+/****************************************************************************/
+static uint16_t to_hundredths(double value) {
+  if(value <= 0)        return 0;
+  if(value >= 655.35)   return 65535;
+  return (uint16_t)(value * 100 + 0.5);
+}
+
+/****************************************************************************/
+/* Courses are wrapped into [0,360) so any angle fits. NaN and infinity     */
+/* give 0                                                                   */
+/****************************************************************************/
+static uint16_t to_course(double degrees) {
+  double   c = fmod(degrees, 360.0);
+  unsigned n;
+
+  if(c < 0) c += 360.0;
+  if(!(c >= 0 && c < 360.0)) return 0;
+  n = (unsigned)(c * 100 + 0.5);
+  return n >= 36000 ? 0 : n;
+}
+
+/****************************************************************************/
+static int32_t to_mm(double metres) {
+  double mm = metres * 1000;
+  if(mm >=  2147483647.0) return  2147483647;
+  if(mm <= -2147483647.0) return -2147483647;
+  return (int32_t)(mm < 0 ? mm - 0.5 : mm + 0.5);
+}
+
+/****************************************************************************/
+void gps_bin_from_fix(gps_bin_record_t *r, const gps_fix_t *fix) {
+  memset(r, 0, sizeof(*r));
+  r->type        = GPS_BIN_FIX;
+  r->flags       = (uint8_t)fix->have;
+  r->fix_quality = (uint8_t)fix->fix_quality;
+  r->no_of_sats  = (uint8_t)fix->no_of_sats;
+  r->time_ms     = fix->time_ms;
+  r->latitude    = to_e7(fix->latitude_ndeg);
+  r->longitude   = to_e7(fix->longitude_ndeg);
+  r->altitude_mm = to_mm(fix->altitude);
+  r->hor_dop     = to_hundredths(fix->hor_dop);
+  r->speed       = to_hundredths(fix->speed_knots);
+  r->course      = to_course(fix->course);
+  r->date        = fix->date;
+}
+
+/****************************************************************************/
+void gps_bin_from_GGA(gps_bin_record_t *r, const gps_GGA_t *gga) {
+  memset(r, 0, sizeof(*r));
+  r->type        = GPS_BIN_GGA;
+  r->fix_quality = (uint8_t)gga->fix_quality;
+  r->no_of_sats  = (uint8_t)gga->no_of_sats;
+  r->time_ms     = gga->time_ms;
+  r->latitude    = to_e7(gga->latitude_ndeg);
+  r->longitude   = to_e7(gga->longitude_ndeg);
+  r->altitude_mm = gga->altitude_mm;
+  r->hor_dop     = to_hundredths(gga->hor_dop);
+}
+
+/****************************************************************************/
+void gps_bin_from_RMC(gps_bin_record_t *r, const gps_RMC_t *rmc) {
+  memset(r, 0, sizeof(*r));
+  r->type        = GPS_BIN_RMC;
+  r->time_ms     = rmc->time_ms;
+  r->latitude    = to_e7(rmc->latitude_ndeg);
+  r->longitude   = to_e7(rmc->longitude_ndeg);
+  r->speed       = to_hundredths(rmc->speed_knots);
+  r->course      = to_course(rmc->course);
+  r->date        = rmc->date;
+}
+
+/****************************************************************************/
+void gps_bin_from_GLL(gps_bin_record_t *r, const gps_GLL_t *gll) {
+  memset(r, 0, sizeof(*r));
+  r->type        = GPS_BIN_GLL;
+  r->time_ms     = gll->time_ms;
+  r->latitude    = to_e7(gll->latitude_ndeg);
+  r->longitude   = to_e7(gll->longitude_ndeg);
+}
+
+/****************************************************************************/
+void gps_bin_from_VTG(gps_bin_record_t *r, const gps_VTG_t *vtg) {
+  memset(r, 0, sizeof(*r));
+  r->type        = GPS_BIN_VTG;
+  r->flags       = (uint8_t)vtg->valid;
+  r->speed       = to_hundredths(vtg->speed_knots);
+  r->course      = to_course(vtg->course_true);
+}
+
+/****************************************************************************/
+int gps_bin_writer_open(gps_bin_writer_t *w, FILE *f) {
+  unsigned char header[16];
+
+  memset(w, 0, sizeof(*w));
+  w->f = f;
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, GPS_BIN_MAGIC, 4);
+  put16(header+4, GPS_BIN_VERSION);
+  put16(header+6, sizeof(gps_bin_record_t));
+  if(fwrite(header, sizeof(header), 1, f) != 1) {
+    w->error = 1;
+    return 0;
+  }
+  return 1;
+}
+
+/****************************************************************************/
+void gps_bin_encode(unsigned char *out, const gps_bin_record_t *r) {
+  out[0] = r->type;
+  out[1] = r->flags;
+  out[2] = r->fix_quality;
+  out[3] = r->no_of_sats;
+  put32(out+4,  r->time_ms);
+  put32(out+8,  (uint32_t)r->latitude);
+  put32(out+12, (uint32_t)r->longitude);
+  put32(out+16, (uint32_t)r->altitude_mm);
+  put16(out+20, r->hor_dop);
+  put16(out+22, r->speed);
+  put16(out+24, r->course);
+  put16(out+26, 0);
+  put32(out+28, r->date);
+}
+
+/****************************************************************************/
+void gps_bin_write(gps_bin_writer_t *w, const gps_bin_record_t *r) {
+  unsigned char out[32];
+
+  gps_bin_encode(out, r);
+  if(fwrite(out, sizeof(out), 1, w->f) != 1)
+    w->error = 1;
+  else
+    w->records++;
+}
+
+/****************************************************************************/
+void gps_bin_fix_callback(void *writer, const gps_fix_t *fix) {
+  gps_bin_record_t r;
+  gps_bin_from_fix(&r, fix);
+  gps_bin_write(writer, &r);
+}
+
+/****************************************************************************/
+void gps_bin_GGA_callback(void *writer, const gps_GGA_t *gga) {
+  gps_bin_record_t r;
+  gps_bin_from_GGA(&r, gga);
+  gps_bin_write(writer, &r);
+}
+
+/****************************************************************************/
+void gps_bin_RMC_callback(void *writer, const gps_RMC_t *rmc) {
+  gps_bin_record_t r;
+  gps_bin_from_RMC(&r, rmc);
+  gps_bin_write(writer, &r);
+}
+
+/****************************************************************************/
+void gps_bin_GLL_callback(void *writer, const gps_GLL_t *gll) {
+  gps_bin_record_t r;
+  gps_bin_from_GLL(&r, gll);
+  gps_bin_write(writer, &r);
+}
+
+/****************************************************************************/
+void gps_bin_VTG_callback(void *writer, const gps_VTG_t *vtg) {
+  gps_bin_record_t r;
+  gps_bin_from_VTG(&r, vtg);
+  gps_bin_write(writer, &r);
+}
+
+/****************************************************************************/
+int gps_bin_reader_open(gps_bin_reader_t *r, const char *path) {
+  const gps_bin_header_t *header;
+  struct stat st;
+  void       *map;
+  int         fd;
+
+  memset(r, 0, sizeof(*r));
+  if(!little_endian()) return 0;
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0) return 0;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(gps_bin_header_t)) {
+    close(fd);
+    return 0;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) return 0;
+
+  header = map;
+  if(memcmp(header->magic, GPS_BIN_MAGIC, 4) != 0
+     || header->version != GPS_BIN_VERSION
+     || header->record_size != sizeof(gps_bin_record_t)) {
+    munmap(map, st.st_size);
+    return 0;
+  }
+
+  r->map   = map;
+  r->size  = st.st_size;
+  r->count = (st.st_size - sizeof(gps_bin_header_t)) / sizeof(gps_bin_record_t);
+  return 1;
+}
+
+/****************************************************************************/
+void gps_bin_reader_close(gps_bin_reader_t *r) {
+  if(r->map)
+    munmap((void *)r->map, r->size);
+  memset(r, 0, sizeof(*r));
+}
+
+/****************************************************************************/
+const gps_bin_record_t *gps_bin_records(const gps_bin_reader_t *r, size_t *count) {
+  *count = r->count;
+  return (const gps_bin_record_t *)(r->map + sizeof(gps_bin_header_t));
+}
+
+/****************************************************************************/
+const gps_bin_record_t *gps_bin_next(gps_bin_reader_t *r) {
+  if(r->next == r->count) return NULL;
+  return (const gps_bin_record_t *)(r->map + sizeof(gps_bin_header_t)) + r->next++;
+}
+/************************ End of file  ***************************************/
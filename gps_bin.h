@@ -0,0 +1,121 @@
+/******************************************************************************
+* gps_bin.h - compact binary fix records
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef GPS_BIN_H
+#define GPS_BIN_H
+#include <stdio.h>
+#include "gps_parse.h"
+
+/****************************************************************************
+* File layout: a 16 byte header, then fixed size 32 byte records, all
+* little-endian. Positions are in 1e-7 degrees (about 1cm), which is as
+* fine as any receiver reports.
+****************************************************************************/
+#define GPS_BIN_MAGIC   "GPSB"
+#define GPS_BIN_VERSION 1
+
+typedef struct gps_bin_header {
+  char     magic[4];
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t reserved[2];
+} gps_bin_header_t;
+
+enum gps_bin_type {
+  GPS_BIN_FIX = 1,            /* from the epoch aggregator, flags = have bits */
+  GPS_BIN_GGA,
+  GPS_BIN_RMC,
+  GPS_BIN_GLL,
+  GPS_BIN_VTG                 /* flags = GPS_VTG_* bits */
+};
+
+typedef struct gps_bin_record {
+  uint8_t  type;
+  uint8_t  flags;
+  uint8_t  fix_quality;
+  uint8_t  no_of_sats;
+  uint32_t time_ms;
+  int32_t  latitude;          /* 1e-7 degrees */
+  int32_t  longitude;
+  int32_t  altitude_mm;
+  uint16_t hor_dop;           /* 1/100ths */
+  uint16_t speed;             /* 1/100ths of a knot */
+  uint16_t course;            /* 1/100ths of a degree, 0 to 35999 */
+  uint16_t reserved;
+  uint32_t date;              /* ddmmyy */
+} gps_bin_record_t;
+
+/****************************************************************************
+* Writer. The gps_bin_*_callback functions can be given straight to a
+* parser whose user pointer is the writer.
+****************************************************************************/
+typedef struct gps_bin_writer {
+  FILE     *f;
+  uint64_t  records;
+  int       error;
+} gps_bin_writer_t;
+
+int  gps_bin_writer_open(gps_bin_writer_t *w, FILE *f);
+void gps_bin_write(gps_bin_writer_t *w, const gps_bin_record_t *record);
+/* Packs a record into its 32 byte file form */
+void gps_bin_encode(unsigned char *out, const gps_bin_record_t *record);
+
+/* Fill in a record from a decoded fix or sentence */
+void gps_bin_from_fix(gps_bin_record_t *r, const gps_fix_t *fix);
+void gps_bin_from_GGA(gps_bin_record_t *r, const gps_GGA_t *gga);
+void gps_bin_from_RMC(gps_bin_record_t *r, const gps_RMC_t *rmc);
+void gps_bin_from_GLL(gps_bin_record_t *r, const gps_GLL_t *gll);
+void gps_bin_from_VTG(gps_bin_record_t *r, const gps_VTG_t *vtg);
+
+void gps_bin_fix_callback(void *writer, const gps_fix_t *fix);
+void gps_bin_GGA_callback(void *writer, const gps_GGA_t *gga);
+void gps_bin_RMC_callback(void *writer, const gps_RMC_t *rmc);
+void gps_bin_GLL_callback(void *writer, const gps_GLL_t *gll);
+void gps_bin_VTG_callback(void *writer, const gps_VTG_t *vtg);
+
+/****************************************************************************
+* Reader. The file is memory mapped and the records are used in place, so
+* this needs a little-endian host - open fails on anything else.
+****************************************************************************/
+typedef struct gps_bin_reader {
+  const unsigned char *map;
+  size_t               size;
+  size_t               count;
+  size_t               next;
+} gps_bin_reader_t;
+
+int  gps_bin_reader_open(gps_bin_reader_t *r, const char *path);
+void gps_bin_reader_close(gps_bin_reader_t *r);
+
+/* All the records as one array */
+const gps_bin_record_t *gps_bin_records(const gps_bin_reader_t *r, size_t *count);
+/* Or one at a time, NULL at the end */
+const gps_bin_record_t *gps_bin_next(gps_bin_reader_t *r);
+#endif
+/************************ End of file  ***************************************/
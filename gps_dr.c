@@ -0,0 +1,178 @@
+/******************************************************************************
+* gps_dr.c - dead reckoning between fixes
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "gps_dr.h"
+
+#define WGS84_A  6378137.0
+#define WGS84_E2 6.69437999014e-3
+#define KNOTS_TO_MS (1852.0/3600.0)
+
+/****************************************************************************/
+void gps_dr_init(gps_dr_t *dr, int order) {
+  memset(dr, 0, sizeof(*dr));
+  dr->order   = order == GPS_DR_CUBIC ? GPS_DR_CUBIC : GPS_DR_LINEAR;
+  dr->max_age = 2.0;
+}
+
+/****************************************************************************/
+/* Metres per nanodegree at the origin, from the WGS84 radii of curvature.  */
+/* This is the only trig, and only happens when the origin moves.           */
+/****************************************************************************/
+static void set_origin(gps_dr_t *dr, const gps_dr_sample_t *s) {
+  double lat = s->latitude_ndeg * 1e-9 * M_PI / 180;
+  double w   = 1 - WGS84_E2 * sin(lat) * sin(lat);
+  double n   = WGS84_A / sqrt(w);               /* prime vertical */
+  double m   = n * (1 - WGS84_E2) / w;          /* meridian */
+  unsigned i;
+
+  dr->origin_lat_ndeg = s->latitude_ndeg;
+  dr->origin_lon_ndeg = s->longitude_ndeg;
+  dr->origin_alt      = s->altitude;
+  dr->m_per_ndeg_lat  = m * M_PI / 180 * 1e-9;
+  dr->m_per_ndeg_lon  = n * cos(lat) * M_PI / 180 * 1e-9;
+  dr->ndeg_per_m_lat  = 1 / dr->m_per_ndeg_lat;
+  dr->ndeg_per_m_lon  = 1 / dr->m_per_ndeg_lon;
+
+  for(i = 0; i < dr->count; i++) {
+    gps_dr_sample_t *r = &dr->ring[(dr->head + GPS_DR_HISTORY - i) % GPS_DR_HISTORY];
+    r->north = (r->latitude_ndeg  - dr->origin_lat_ndeg) * dr->m_per_ndeg_lat;
+    r->east  = (r->longitude_ndeg - dr->origin_lon_ndeg) * dr->m_per_ndeg_lon;
+    r->up    = r->altitude - dr->origin_alt;
+  }
+}
+
+/****************************************************************************/
+/* The polynomial through the newest n samples, from Newton's divided       */
+/* differences, multiplied out into powers of dt                            */
+/****************************************************************************/
+static void fit(gps_dr_t *dr, unsigned n) {
+  double dt[GPS_DR_HISTORY], d[3][GPS_DR_HISTORY];
+  unsigned i, j, axis;
+
+  for(i = 0; i < n; i++) {
+    const gps_dr_sample_t *s = &dr->ring[(dr->head + GPS_DR_HISTORY - i) % GPS_DR_HISTORY];
+    dt[i]   = s->t - dr->t0;
+    d[0][i] = s->east;
+    d[1][i] = s->north;
+    d[2][i] = s->up;
+  }
+  for(axis = 0; axis < 3; axis++) {
+    double *a = d[axis], *c = dr->coef[axis];
+
+    for(j = 1; j < n; j++)
+      for(i = n-1; i >= j; i--)
+        a[i] = (a[i] - a[i-1]) / (dt[i] - dt[i-j]);
+
+    /* c = a[n-1], then c = c*(x - dt[j]) + a[j] for j = n-2 down to 0 */
+    memset(c, 0, 4 * sizeof(double));
+    c[0] = a[n-1];
+    for(j = n-1; j-- > 0;) {
+      for(i = n-1-j; i > 0; i--)
+        c[i] = c[i-1] - dt[j] * c[i];
+      c[0] = a[j] - dt[j] * c[0];
+    }
+  }
+}
+
+/****************************************************************************/
+void gps_dr_add(gps_dr_t *dr, double t, const gps_fix_t *fix) {
+  gps_dr_sample_t *s;
+  double           altitude;
+
+  if(!(fix->have & GPS_FIX_POSITION)) return;
+  if(dr->count > 0 && t <= dr->ring[dr->head].t) return;
+
+  altitude = fix->have & GPS_FIX_ALTITUDE ? fix->altitude
+           : dr->count > 0 ? dr->ring[dr->head].altitude : 0;
+
+  dr->head = (dr->head + 1) % GPS_DR_HISTORY;
+  if(dr->count < GPS_DR_HISTORY) dr->count++;
+  s = &dr->ring[dr->head];
+  s->t              = t;
+  s->latitude_ndeg  = fix->latitude_ndeg;
+  s->longitude_ndeg = fix->longitude_ndeg;
+  s->altitude       = altitude;
+  s->north = (s->latitude_ndeg  - dr->origin_lat_ndeg) * dr->m_per_ndeg_lat;
+  s->east  = (s->longitude_ndeg - dr->origin_lon_ndeg) * dr->m_per_ndeg_lon;
+  s->up    = s->altitude - dr->origin_alt;
+
+  if(dr->count == 1 || fabs(s->north) > GPS_DR_RECENTRE_M || fabs(s->east) > GPS_DR_RECENTRE_M)
+    set_origin(dr, s);
+
+  dr->t0 = t;
+  if(dr->order == GPS_DR_CUBIC) {
+    fit(dr, dr->count);
+    return;
+  }
+
+  fit(dr, dr->count < 2 ? 1 : 2);
+  if(fix->have & GPS_FIX_VELOCITY) {
+    double course = fix->course * M_PI / 180;
+    double speed  = fix->speed_knots * KNOTS_TO_MS;
+    dr->coef[0][1] = speed * sin(course);
+    dr->coef[1][1] = speed * cos(course);
+  }
+}
+
+/****************************************************************************/
+void gps_dr_fix_callback(void *user, const gps_fix_t *fix) {
+  gps_dr_t *dr = user;
+  double    t;
+
+  if(!(fix->have & GPS_FIX_TIME)) return;
+  t = dr->day_offset + fix->time_ms * 0.001;
+  if(dr->count > 0 && t < dr->ring[dr->head].t - 43200) {
+    dr->day_offset += 86400;
+    t += 86400;
+  }
+  gps_dr_add(dr, t, fix);
+}
+
+/****************************************************************************/
+int gps_dr_position_at(const gps_dr_t *dr, double t, gps_dr_position_t *pos) {
+  const double (*c)[4] = dr->coef;
+  double dt = t - dr->t0;
+
+  if(dr->count == 0 || dt > dr->max_age) return 0;
+
+  pos->east      = ((c[0][3]*dt + c[0][2])*dt + c[0][1])*dt + c[0][0];
+  pos->north     = ((c[1][3]*dt + c[1][2])*dt + c[1][1])*dt + c[1][0];
+  pos->up        = ((c[2][3]*dt + c[2][2])*dt + c[2][1])*dt + c[2][0];
+  pos->vel_east  = (3*c[0][3]*dt + 2*c[0][2])*dt + c[0][1];
+  pos->vel_north = (3*c[1][3]*dt + 2*c[1][2])*dt + c[1][1];
+  pos->vel_up    = (3*c[2][3]*dt + 2*c[2][2])*dt + c[2][1];
+
+  pos->latitude  = (dr->origin_lat_ndeg + pos->north * dr->ndeg_per_m_lat) * 1e-9;
+  pos->longitude = (dr->origin_lon_ndeg + pos->east  * dr->ndeg_per_m_lon) * 1e-9;
+  pos->altitude  = dr->origin_alt + pos->up;
+  return 1;
+}
+/************************ End of file  ***************************************/
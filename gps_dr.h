@@ -0,0 +1,103 @@
+/******************************************************************************
+* gps_dr.h - dead reckoning between fixes
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef GPS_DR_H
+#define GPS_DR_H
+#include "gps_parse.h"
+
+/****************************************************************************
+* Answers "where are we at time t" at any rate from fixes arriving at a few
+* Hz. Each fix is converted into metres east, north and up of a local
+* origin, and a polynomial in time is fitted for each axis as the fix
+* arrives. A query is then just three polynomial evaluations - no trig and
+* no loops. Times are in seconds, on whatever clock the fixes were given.
+*
+* Linear uses the fix's speed and course when it has them, otherwise the
+* last two positions. Cubic passes through the last four positions, so it
+* follows turns better but strays faster when extrapolated a long way.
+****************************************************************************/
+#define GPS_DR_HISTORY    4
+#define GPS_DR_LINEAR     1
+#define GPS_DR_CUBIC      3
+#define GPS_DR_RECENTRE_M 10000.0   /* move the origin when further than this */
+
+typedef struct gps_dr_sample {
+  double    t;
+  int64_t   latitude_ndeg;
+  int64_t   longitude_ndeg;
+  double    altitude;
+  double    east, north, up;
+} gps_dr_sample_t;
+
+typedef struct gps_dr_position {
+  double    east, north, up;                /* metres from the origin */
+  double    vel_east, vel_north, vel_up;    /* m/s */
+  double    latitude, longitude, altitude;  /* degrees, metres */
+} gps_dr_position_t;
+
+typedef struct gps_dr {
+  int       order;            /* GPS_DR_LINEAR or GPS_DR_CUBIC */
+  double    max_age;          /* queries further than this past the last fix fail */
+
+  /* Local frame */
+  int64_t   origin_lat_ndeg;
+  int64_t   origin_lon_ndeg;
+  double    origin_alt;
+  double    m_per_ndeg_lat;
+  double    m_per_ndeg_lon;
+  double    ndeg_per_m_lat;
+  double    ndeg_per_m_lon;
+
+  /* The most recent fixes, newest at ring[head] */
+  gps_dr_sample_t ring[GPS_DR_HISTORY];
+  unsigned  count;
+  unsigned  head;
+
+  /* p(t) = coef[0] + coef[1]*dt + coef[2]*dt^2 + coef[3]*dt^3, dt = t - t0 */
+  double    t0;
+  double    coef[3][4];
+
+  /* Day rollover for gps_dr_fix_callback() */
+  double    day_offset;
+} gps_dr_t;
+
+void gps_dr_init(gps_dr_t *dr, int order);
+
+/* Adds a fix with a position, taken at time t. Older or repeated times are
+   ignored */
+void gps_dr_add(gps_dr_t *dr, double t, const gps_fix_t *fix);
+
+/* A gps_fix_callback_func for a parser whose user pointer is the engine.
+   t is the fix time of day, counting on past midnight */
+void gps_dr_fix_callback(void *dr, const gps_fix_t *fix);
+
+/* Returns 0 if there is no fix yet, or t is more than max_age after it */
+int  gps_dr_position_at(const gps_dr_t *dr, double t, gps_dr_position_t *pos);
+#endif
+/************************ End of file  ***************************************/
@@ -0,0 +1,266 @@
+/******************************************************************************
+* gps_field.c - typed access to the fields of a sentence
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <string.h>
+#include <limits.h>
+#include "gps_parse.h"
+
+/* Numbers are gathered into an integer mantissa, and only converted to a
+   double at the end with a single division by an exact power of ten. That
+   is both quicker and correctly rounded for up to 15 significant digits */
+#define MAX_DECIMALS 12
+#define MAX_MANTISSA 100000000000000000ull   /* 1e17 */
+
+static const double pow10_double[MAX_DECIMALS+1] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12
+};
+
+static const int64_t pow10_int[MAX_DECIMALS+1] = {
+  1ll, 10ll, 100ll, 1000ll, 10000ll, 100000ll, 1000000ll, 10000000ll,
+  100000000ll, 1000000000ll, 10000000000ll, 100000000000ll, 1000000000000ll
+};
+
+/****************************************************************************/
+const char *gps_field(const gps_sentence_t *s, int fieldno, unsigned *len) {
+  if(fieldno < 0 || (unsigned)fieldno >= s->fields) return NULL;
+  *len = s->start[fieldno+1] - s->start[fieldno] - 1;
+  return s->text + s->start[fieldno];
+}
+
+/****************************************************************************/
+int gps_field_present(const gps_sentence_t *s, int fieldno) {
+  unsigned len;
+  if(gps_field(s, fieldno, &len) == NULL) return 0;
+  return len > 0;
+}
+
+/****************************************************************************/
+int gps_field_char(const gps_sentence_t *s, int fieldno, char *dest, char *acceptible) {
+  unsigned len;
+  const char *f = gps_field(s, fieldno, &len);
+
+  /* Must be exactly one character */
+  if(f == NULL || len != 1) return 0;
+
+  /* Look for match */
+  while(*acceptible != '\0' && *acceptible != *f) 
+     acceptible++;
+
+  /* Check a match was found */
+  if(*acceptible == '\0') return 0;
+
+  *dest = *f;
+  return 1;
+}
+
+/****************************************************************************/
+int gps_field_uint(const gps_sentence_t *s, int fieldno, unsigned *dest) {
+  unsigned i = 0, len;
+  unsigned value = 0;
+  const char *f = gps_field(s, fieldno, &len);
+  if(f == NULL) return 0;
+
+  while(i < len && f[i] >= '0' && f[i] <= '9') {
+    /* Too big for an unsigned */
+    if(value > (UINT_MAX - (f[i]-'0')) / 10) return 0;
+    value = value*10 + f[i]-'0';
+    i++;
+  }
+  /* Check that the whole field was used */
+  if(i != len) return 0;
+
+  *dest = value;
+  return 1;
+}
+
+/****************************************************************************/
+int gps_field_number(const gps_sentence_t *s, int fieldno, int64_t *mantissa, int *decimals) {
+  unsigned i = 0, len;
+  int64_t  value = 0;
+  int      places = 0;
+  int      negative = 0;
+  const char *f = gps_field(s, fieldno, &len);
+  if(f == NULL) return 0;
+
+  if(i < len && f[i] == '-') {
+    negative = 1;
+    i++;
+  }
+
+  while(i < len && f[i] >= '0' && f[i] <= '9') {
+    /* Too big to be a real value */
+    if(value >= (int64_t)MAX_MANTISSA) return 0;
+    value = value*10 + f[i]-'0';
+    i++;
+  }
+  if(i < len && f[i] == '.') {
+    i++;
+    while(i < len && f[i] >= '0' && f[i] <= '9') {
+      /* Digits past what we can hold are ignored */
+      if(places < MAX_DECIMALS && value < (int64_t)MAX_MANTISSA) {
+        value = value*10 + f[i]-'0';
+        places++;
+      }
+      i++;
+    }
+  }
+  /* Check that the whole field was used */
+  if(i != len) return 0;
+
+  *mantissa = negative ? -value : value;
+  *decimals = places;
+  return 1;
+}
+
+/****************************************************************************/
+int gps_field_double(const gps_sentence_t *s, int fieldno, double *dest) {
+  int64_t mantissa;
+  int     decimals;
+
+  if(!gps_field_number(s, fieldno, &mantissa, &decimals)) return 0;
+  *dest = (double)mantissa / pow10_double[decimals];
+  return 1;
+}
+
+/****************************************************************************/
+int gps_field_scaled(const gps_sentence_t *s, int fieldno, int decimals, int64_t *dest, double *value) {
+  int64_t mantissa;
+  int     places;
+
+  if(decimals < 0 || decimals > MAX_DECIMALS) return 0;
+  if(!gps_field_number(s, fieldno, &mantissa, &places)) return 0;
+
+  if(places <= decimals) {
+    int64_t mul = pow10_int[decimals-places];
+    if(mantissa > INT64_MAX / mul || mantissa < -(INT64_MAX / mul)) return 0;
+    *dest = mantissa * mul;
+  } else {
+    /* Round half away from zero */
+    int64_t div  = pow10_int[places-decimals];
+    int64_t half = div/2;
+    *dest = (mantissa + (mantissa < 0 ? -half : half)) / div;
+  }
+  if(value != NULL)
+    *value = (double)mantissa / pow10_double[places];
+  return 1;
+}
+
+/****************************************************************************/
+int gps_field_angle_fixed(const gps_sentence_t *s, int fieldno, int64_t *ndeg, double *dest) {
+  int64_t  mantissa, degrees, minutes, scale, fraction;
+  int      decimals, negative = 0;
+
+  /* The field is [d]ddmm.mmmm, so mantissa is that times 10^decimals */
+  if(!gps_field_number(s, fieldno, &mantissa, &decimals)) return 0;
+  if(mantissa < 0) {
+    negative = 1;
+    mantissa = -mantissa;
+  }
+
+  scale   = pow10_int[decimals];
+  degrees = mantissa / (100*scale);
+  minutes = mantissa % (100*scale);
+  if(degrees > 180 || minutes >= 60*scale) return 0;
+
+  /* Convert minutes*10^decimals to nanodegrees, rounded to nearest */
+  if(decimals <= 9) {
+    fraction = (minutes * pow10_int[9-decimals] + 30) / 60;
+  } else {
+    int64_t div = 60 * pow10_int[decimals-9];
+    fraction = (minutes + div/2) / div;
+  }
+
+  *ndeg = degrees * 1000000000ll + fraction;
+  if(negative) *ndeg = -*ndeg;
+
+  if(dest != NULL) {
+    *dest = (double)degrees + (double)minutes / (60.0 * pow10_double[decimals]);
+    if(negative) *dest = -*dest;
+  }
+  return 1;
+}
+
+/****************************************************************************/
+int gps_field_angle(const gps_sentence_t *s, int fieldno, double *dest) {
+  int64_t ndeg;
+  return gps_field_angle_fixed(s, fieldno, &ndeg, dest);
+}
+
+/****************************************************************************/
+int gps_field_position(const gps_sentence_t *s, int fieldno, int64_t *ndeg, double *dest) {
+  char hemisphere;
+
+  if(!gps_field_angle_fixed(s, fieldno, ndeg, dest)) return 0;
+  if(!gps_field_char(s, fieldno+1, &hemisphere, "NSEW")) return 0;
+  if((hemisphere == 'N' || hemisphere == 'S') && *ndeg > GPS_MAX_LATITUDE_NDEG) return 0;
+  if(hemisphere == 'S' || hemisphere == 'W') {
+    *ndeg = -*ndeg;
+    if(dest != NULL) *dest = -*dest;
+  }
+  return 1;
+}
+
+/****************************************************************************/
+int gps_field_time(const gps_sentence_t *s, int fieldno, unsigned *ms, double *timestamp) {
+  int64_t hhmmss_ms, mantissa;
+  int     places;
+
+  /* hhmmss.ss, kept to the millisecond. Extra digits are dropped rather
+     than rounded, so 235959.9995 can't become the start of the next day */
+  if(!gps_field_number(s, fieldno, &mantissa, &places) || mantissa < 0) return 0;
+  if(places <= 3) {
+    int64_t mul = pow10_int[3-places];
+    if(mantissa > INT64_MAX / mul) return 0;
+    hhmmss_ms = mantissa * mul;
+  } else {
+    hhmmss_ms = mantissa / pow10_int[places-3];
+  }
+  if(timestamp != NULL)
+    *timestamp = (double)mantissa / pow10_double[places];
+  /* Seconds can reach 60 for a leap second */
+  if(hhmmss_ms >= 24*10000000
+     || hhmmss_ms / 100000 % 100 >= 60 || hhmmss_ms % 100000 >= 61000) return 0;
+
+  *ms = (unsigned)(hhmmss_ms / 10000000 * 3600000
+                 + hhmmss_ms / 100000 % 100 * 60000
+                 + hhmmss_ms % 100000);
+  return 1;
+}
+
+/****************************************************************************/
+int64_t gps_utc_days(int year, unsigned month, unsigned day) {
+  /* Counting from March, so the leap day is at the end of the year */
+  int64_t  y   = (int64_t)year - (month <= 2);
+  int64_t  era = (y >= 0 ? y : y-399) / 400;
+  unsigned yoe = (unsigned)(y - era*400);
+  unsigned doy = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day-1;
+  unsigned doe = yoe*365 + yoe/4 - yoe/100 + doy;
+  return era*146097 + doe - 719468;
+}
+/************************ End of file  ***************************************/
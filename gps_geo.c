@@ -0,0 +1,282 @@
+/******************************************************************************
+* gps_geo.c - batch geodesy on columns of fixes
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <math.h>
+#include "gps_geo.h"
+
+#define WGS84_A      6378137.0
+#define WGS84_E2     6.69437999014e-3
+#define MEAN_RADIUS  6371008.8
+#define DEG_TO_RAD   (M_PI / 180)
+
+/* Adding and taking away 1.5 * 2^52 rounds a double to a whole number */
+#define ROUND_MAGIC  6755399441055744.0
+
+/* pi/2 split in two so that x - k*pi/2 loses nothing for small k */
+#define PIO2_HI      1.57079632673412561417e+00
+#define PIO2_LO      6.07710050650619224932e-11
+
+/* Everything below the public functions is inlined into them, or the AVX2
+   copies would call out to baseline code */
+#ifdef __GNUC__
+#define GEO_INLINE   static inline __attribute__((always_inline))
+#else
+#define GEO_INLINE   static inline
+#endif
+
+/****************************************************************************/
+/* sin and cos together. x is reduced to r in [-pi/4, pi/4] and a quadrant, */
+/* and Taylor series in r^2 are used - up to r^15 / r^16 when precise,      */
+/* which is below double rounding, or r^11 / r^12 when fast (error < 1e-11) */
+/* Only ever called with |x| <= 2pi. Everything, quadrant included, stays  */
+/* in doubles with no branches, so that loops calling it vectorise.         */
+/****************************************************************************/
+GEO_INLINE double round_whole(double x) {
+  return (x + ROUND_MAGIC) - ROUND_MAGIC;
+}
+
+GEO_INLINE void sin_cos(double x, double *sin_x, double *cos_x, int fast) {
+  double k = round_whole(x * (2 / M_PI));
+  double q = k - 4 * round_whole(k * 0.25);     /* quadrant, -2 to 2 */
+  double r = (x - k * PIO2_HI) - k * PIO2_LO;
+  double z = r * r;
+  double s, c;
+
+  if(fast) {
+    s = r + r*z*(-1.0/6 + z*(1.0/120 + z*(-1.0/5040 + z*(1.0/362880 + z*(-1.0/39916800)))));
+    c = 1 + z*(-0.5 + z*(1.0/24 + z*(-1.0/720 + z*(1.0/40320 + z*(-1.0/3628800 + z*(1.0/479001600))))));
+  } else {
+    s = r + r*z*(-1.0/6 + z*(1.0/120 + z*(-1.0/5040 + z*(1.0/362880 + z*(-1.0/39916800
+          + z*(1.0/6227020800 + z*(-1.0/1307674368000)))))));
+    c = 1 + z*(-0.5 + z*(1.0/24 + z*(-1.0/720 + z*(1.0/40320 + z*(-1.0/3628800
+          + z*(1.0/479001600 + z*(-1.0/87178291200 + z*(1.0/20922789888000))))))));
+  }
+
+  /* Rotate by the quadrant. -2 and 2 are the same quadrant, as are -1 and 3 */
+  *sin_x = fabs(q) == 1 ? c : s;
+  *cos_x = fabs(q) == 1 ? s : c;
+  *sin_x = ((fabs(q) == 2) | (q == -1)) ? -*sin_x : *sin_x;
+  *cos_x = ((fabs(q) == 2) | (q ==  1)) ? -*cos_x : *cos_x;
+}
+
+/****************************************************************************/
+/* asin for 0 <= x <= 1. Up to 0.5 it is x * P(x^2), where P is fitted to   */
+/* asin(x)/x at Chebyshev points - 13 terms are below double rounding, 7    */
+/* are good to 3e-10. Above 0.5, asin(x) = pi/2 - 2 asin(sqrt((1 - x)/2))   */
+/* brings it back into range, for a single sqrt either way.                 */
+/****************************************************************************/
+GEO_INLINE double asin_pos(double x, int fast) {
+  double t = x > 0.5 ? (1 - x) * 0.5 : x * x;
+  double s = x > 0.5 ? sqrt(t) : x;
+  double p;
+
+  if(fast)
+    p = 1.0000000002307783 + t*(0.16666657639575913 + t*(0.07500571381024686 + t*(0.04450870949865153
+        + t*(0.03185718889411276 + t*(0.014295256037820107 + t*0.0376771383418486)))));
+  else
+    p = 1.0 + t*(0.16666666666664942 + t*(0.07500000000385201 + t*(0.044642856805998936
+        + t*(0.03038195969768514 + t*(0.022371749733164054 + t*(0.01735977964134998
+        + t*(0.01388484282640208 + t*(0.012170138592391726 + t*(0.0065293020047365695
+        + t*(0.019513468251252167 + t*(-0.016187392271599134 + t*0.03187962140081284)))))))))));
+
+  return x > 0.5 ? M_PI_2 - 2 * (s * p) : s * p;
+}
+
+/****************************************************************************/
+GEO_INLINE void to_ecef(double latitude, double longitude, double altitude,
+                        double *x, double *y, double *z, int fast) {
+  double sin_lat, cos_lat, sin_lon, cos_lon, n;
+
+  sin_cos(latitude  * DEG_TO_RAD, &sin_lat, &cos_lat, fast);
+  sin_cos(longitude * DEG_TO_RAD, &sin_lon, &cos_lon, fast);
+  n  = WGS84_A / sqrt(1 - WGS84_E2 * sin_lat * sin_lat);
+  *x = (n + altitude) * cos_lat * cos_lon;
+  *y = (n + altitude) * cos_lat * sin_lon;
+  *z = (n * (1 - WGS84_E2) + altitude) * sin_lat;
+}
+
+/****************************************************************************/
+GEO_INLINE void ecef_loop(const double *latitude, const double *longitude, const double *altitude, size_t n,
+                          double *x, double *y, double *z, int fast) {
+  size_t i;
+  if(altitude == NULL) {
+    for(i = 0; i < n; i++)
+      to_ecef(latitude[i], longitude[i], 0, &x[i], &y[i], &z[i], fast);
+  } else {
+    for(i = 0; i < n; i++)
+      to_ecef(latitude[i], longitude[i], altitude[i], &x[i], &y[i], &z[i], fast);
+  }
+}
+
+/****************************************************************************/
+GEO_INLINE void enu_loop(const double *latitude, const double *longitude, const double *altitude, size_t n,
+                         const double ref_position[3], const double rot[3][3],
+                         double *east, double *north, double *up, int fast) {
+  double ref[3];
+  size_t i;
+
+  /* The reference goes through the same to_ecef() as the points, so they
+     cancel exactly at the reference itself. The outputs hold ECEF first. */
+  to_ecef(ref_position[0], ref_position[1], ref_position[2], &ref[0], &ref[1], &ref[2], fast);
+  ecef_loop(latitude, longitude, altitude, n, east, north, up, fast);
+  for(i = 0; i < n; i++) {
+    double x = east[i]  - ref[0];
+    double y = north[i] - ref[1];
+    double z = up[i]    - ref[2];
+    east[i]  = rot[0][0]*x + rot[0][1]*y;
+    north[i] = rot[1][0]*x + rot[1][1]*y + rot[1][2]*z;
+    up[i]    = rot[2][0]*x + rot[2][1]*y + rot[2][2]*z;
+  }
+}
+
+/****************************************************************************/
+GEO_INLINE double haversine(double lat1, double lon1, double lat2, double lon2,
+                            double cos_lat1, double cos_lat2, int fast) {
+  double sin_dlat, sin_dlon, unused, a;
+
+  sin_cos((lat2 - lat1) * (DEG_TO_RAD / 2), &sin_dlat, &unused, fast);
+  sin_cos((lon2 - lon1) * (DEG_TO_RAD / 2), &sin_dlon, &unused, fast);
+  a = sin_dlat * sin_dlat + cos_lat1 * cos_lat2 * sin_dlon * sin_dlon;
+  a = a > 1 ? 1 : a;
+  return 2 * MEAN_RADIUS * asin_pos(sqrt(a), fast);
+}
+
+GEO_INLINE void distance_loop(const double *latitude, const double *longitude, size_t n,
+                              double *distance, int fast) {
+  double unused, cos_last;
+  size_t i;
+
+  /* Each latitude's cosine is used twice, so they are worked out first in
+     the output column, then overwritten from the front */
+  for(i = 0; i+1 < n; i++)
+    sin_cos(latitude[i] * DEG_TO_RAD, &unused, &distance[i], fast);
+  sin_cos(latitude[n-1] * DEG_TO_RAD, &unused, &cos_last, fast);
+
+  for(i = 0; i+2 < n; i++)
+    distance[i] = haversine(latitude[i], longitude[i], latitude[i+1], longitude[i+1],
+                            distance[i], distance[i+1], fast);
+  distance[n-2] = haversine(latitude[n-2], longitude[n-2], latitude[n-1], longitude[n-1],
+                            distance[n-2], cos_last, fast);
+}
+
+/****************************************************************************/
+/* The loops are built once for the baseline instruction set and, on        */
+/* x86-64, again for AVX2 and FMA, which is picked at runtime like the      */
+/* sentence scanner. Each copy has fast as a constant. The restrict outputs */
+/* spare the compiler run time overlap checks, of which it will only do     */
+/* ten per loop.                                                            */
+/****************************************************************************/
+#define GEO_KERNELS(suffix)                                                                             \
+static void ecef_##suffix(const double *latitude, const double *longitude, const double *altitude,     \
+                          size_t n, double *restrict x, double *restrict y, double *restrict z,        \
+                          int fast) {                                                                  \
+  if(fast) ecef_loop(latitude, longitude, altitude, n, x, y, z, 1);                                    \
+  else     ecef_loop(latitude, longitude, altitude, n, x, y, z, 0);                                    \
+}                                                                                                      \
+static void enu_##suffix(const double *latitude, const double *longitude, const double *altitude,      \
+                         size_t n, const double ref[3], const double rot[3][3],                        \
+                         double *restrict east, double *restrict north, double *restrict up,           \
+                         int fast) {                                                                   \
+  if(fast) enu_loop(latitude, longitude, altitude, n, ref, rot, east, north, up, 1);                   \
+  else     enu_loop(latitude, longitude, altitude, n, ref, rot, east, north, up, 0);                   \
+}                                                                                                      \
+static void distance_##suffix(const double *latitude, const double *longitude, size_t n,               \
+                              double *restrict distance, int fast) {                                   \
+  if(fast) distance_loop(latitude, longitude, n, distance, 1);                                         \
+  else     distance_loop(latitude, longitude, n, distance, 0);                                         \
+}
+
+GEO_KERNELS(base)
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(GPS_NO_SIMD)
+#define GPS_GEO_X86
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+GEO_KERNELS(avx2)
+#pragma GCC pop_options
+#endif
+
+static int use_avx2(void) {
+#ifdef GPS_GEO_X86
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+  return 0;
+#endif
+}
+
+/****************************************************************************/
+void gps_geo_ecef(const double *latitude, const double *longitude, const double *altitude, size_t n,
+                  double *restrict x, double *restrict y, double *restrict z, int mode) {
+#ifdef GPS_GEO_X86
+  if(use_avx2()) {
+    ecef_avx2(latitude, longitude, altitude, n, x, y, z, mode == GPS_GEO_FAST);
+    return;
+  }
+#endif
+  ecef_base(latitude, longitude, altitude, n, x, y, z, mode == GPS_GEO_FAST);
+}
+
+/****************************************************************************/
+void gps_geo_enu(const double *latitude, const double *longitude, const double *altitude, size_t n,
+                 double ref_latitude, double ref_longitude, double ref_altitude,
+                 double *restrict east, double *restrict north, double *restrict up, int mode) {
+  double ref[3], rot[3][3];
+  double sin_lat = sin(ref_latitude  * DEG_TO_RAD), cos_lat = cos(ref_latitude  * DEG_TO_RAD);
+  double sin_lon = sin(ref_longitude * DEG_TO_RAD), cos_lon = cos(ref_longitude * DEG_TO_RAD);
+
+  ref[0] = ref_latitude;
+  ref[1] = ref_longitude;
+  ref[2] = ref_altitude;
+  rot[0][0] = -sin_lon;           rot[0][1] =  cos_lon;           rot[0][2] = 0;
+  rot[1][0] = -sin_lat * cos_lon; rot[1][1] = -sin_lat * sin_lon; rot[1][2] = cos_lat;
+  rot[2][0] =  cos_lat * cos_lon; rot[2][1] =  cos_lat * sin_lon; rot[2][2] = sin_lat;
+
+#ifdef GPS_GEO_X86
+  if(use_avx2()) {
+    enu_avx2(latitude, longitude, altitude, n, ref, (const double (*)[3])rot, east, north, up, mode == GPS_GEO_FAST);
+    return;
+  }
+#endif
+  enu_base(latitude, longitude, altitude, n, ref, (const double (*)[3])rot, east, north, up, mode == GPS_GEO_FAST);
+}
+
+/****************************************************************************/
+void gps_geo_distance(const double *latitude, const double *longitude, size_t n,
+                      double *restrict distance, int mode) {
+  if(n < 2) return;
+#ifdef GPS_GEO_X86
+  if(use_avx2()) {
+    distance_avx2(latitude, longitude, n, distance, mode == GPS_GEO_FAST);
+    return;
+  }
+#endif
+  distance_base(latitude, longitude, n, distance, mode == GPS_GEO_FAST);
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,71 @@
+/******************************************************************************
+* gps_geo.h - batch geodesy on columns of fixes
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef GPS_GEO_H
+#define GPS_GEO_H
+#include <stddef.h>
+
+/****************************************************************************
+* Conversions over whole columns of positions, such as those filled in by a
+* gps_batch_t: latitude and longitude in degrees, altitude in metres above
+* the WGS84 ellipsoid (NULL for all zero). The loops have no calls or
+* branches in them, using polynomial trig instead of libm, so the compiler
+* can vectorise them. On x86-64 an AVX2 build of them is used when the CPU
+* has it. Output columns must not overlap the inputs or each other.
+*
+* Against the same formulas in long double (test/geo.c checks these):
+*
+*   GPS_GEO_PRECISE  ECEF and ENU within 1e-8 m, distances within 1e-13
+*                    of their length - as close as libm in double gets
+*   GPS_GEO_FAST     shorter polynomials: ECEF within 0.1mm, ENU within
+*                    0.01mm, distances within 1e-9 of their length and 1cm
+*
+* Within about 10km of the antipode the haversine itself is ill
+* conditioned: an error e in its sines becomes 2R sqrt(e) in the distance.
+* There distances can be out by up to 0.2m when precise (libm is the
+* same) and 50m when fast.
+****************************************************************************/
+#define GPS_GEO_PRECISE 0
+#define GPS_GEO_FAST    1
+
+/* Earth-centred, earth-fixed x, y, z in metres */
+void gps_geo_ecef(const double *latitude, const double *longitude, const double *altitude, size_t n,
+                  double *restrict x, double *restrict y, double *restrict z, int mode);
+
+/* East, north and up in metres from a reference position */
+void gps_geo_enu(const double *latitude, const double *longitude, const double *altitude, size_t n,
+                 double ref_latitude, double ref_longitude, double ref_altitude,
+                 double *restrict east, double *restrict north, double *restrict up, int mode);
+
+/* Great circle (haversine) distance in metres from each point to the next,
+   so n points give n-1 distances */
+void gps_geo_distance(const double *latitude, const double *longitude, size_t n,
+                      double *restrict distance, int mode);
+#endif
+/************************ End of file  ***************************************/
@@ -0,0 +1,180 @@
+/******************************************************************************
+* gps_merge.c - one stream of fixes from redundant receivers
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <string.h>
+#include "gps_merge.h"
+
+#define SLOT_MASK (GPS_MERGE_SLOTS-1)
+#define DAY_MS    86400000
+
+/****************************************************************************/
+int gps_merge_init(gps_merge_t *m, unsigned sources, unsigned window_ms,
+                   gps_fix_callback_func out, void *user) {
+  unsigned i;
+
+  if(sources == 0 || sources > GPS_MERGE_MAX_SOURCES) return 0;
+  memset(m, 0, sizeof(*m));
+  m->nsources  = sources;
+  m->window_ms = window_ms;
+  m->out       = out;
+  m->user      = user;
+  for(i = 0; i < sources; i++) {
+    m->source[i].merge = m;
+    m->source[i].index = i;
+  }
+  return 1;
+}
+
+/****************************************************************************/
+/* b - a in milliseconds, taking the shorter way round midnight             */
+/****************************************************************************/
+static int time_diff(unsigned a, unsigned b) {
+  int d = (int)(((int64_t)b - a + DAY_MS) % DAY_MS);
+  return d >= DAY_MS/2 ? d - DAY_MS : d;
+}
+
+/****************************************************************************/
+/* Whether a is a better fix than b. fix_quality is ranked RTK fixed, RTK   */
+/* float, differential or PPS, GPS, then dead reckoning; manual, simulated  */
+/* and invalid count for nothing                                            */
+/****************************************************************************/
+static const unsigned char quality_rank[9] = { 0, 2, 3, 3, 5, 4, 1, 0, 0 };
+
+static unsigned rank(const gps_fix_t *f) {
+  if(!(f->have & GPS_FIX_QUALITY) || f->fix_quality >= sizeof(quality_rank)) return 0;
+  return quality_rank[f->fix_quality];
+}
+
+static int better(const gps_fix_t *a, const gps_fix_t *b) {
+  unsigned pa = a->have & GPS_FIX_POSITION, pb = b->have & GPS_FIX_POSITION;
+  double   da, db;
+
+  if(pa != pb)                        return pa != 0;
+  if(rank(a) != rank(b))              return rank(a) > rank(b);
+  if(a->no_of_sats != b->no_of_sats)  return a->no_of_sats > b->no_of_sats;
+  /* A hor_dop of 0 was not sent */
+  da = a->hor_dop > 0 ? a->hor_dop : 1e9;
+  db = b->hor_dop > 0 ? b->hor_dop : 1e9;
+  return da < db;
+}
+
+/****************************************************************************/
+static void pass_on_oldest(gps_merge_t *m) {
+  const gps_merge_epoch_t *e = &m->slot[m->head];
+
+  m->head    = (m->head+1) & SLOT_MASK;
+  m->count--;
+  m->last_ms = e->fix.time_ms;
+  m->started = 1;
+  m->source[e->best].chosen++;
+  m->out_source = e->best;
+  if(m->out)
+    m->out(m->user, &e->fix);
+}
+
+/****************************************************************************/
+void gps_merge_add(gps_merge_t *m, unsigned source, const gps_fix_t *fix) {
+  gps_merge_epoch_t *e;
+  unsigned n, k;
+  int      d = -1;
+
+  if(source >= m->nsources) return;
+  m->source[source].fixes++;
+  if(!(fix->have & GPS_FIX_TIME)) {
+    m->untimed++;
+    return;
+  }
+  if(m->started && time_diff(m->last_ms, fix->time_ms) <= 0) {
+    m->late++;
+    return;
+  }
+
+  /* Look for the epoch from the newest end, as fixes mostly come in order.
+     It is either slot n-1, or a new one goes in at n */
+  for(n = m->count; n > 0; n--) {
+    e = &m->slot[(m->head + n-1) & SLOT_MASK];
+    d = time_diff(e->fix.time_ms, fix->time_ms);
+    if(d >= 0) break;
+  }
+
+  if(n > 0 && d == 0) {
+    n--;
+    if(better(fix, &e->fix)) {
+      e->fix  = *fix;
+      e->best = source;
+    }
+    e->sources |= 1u << source;
+  } else {
+    if(m->count == GPS_MERGE_SLOTS) {
+      m->overflow++;
+      if(n == 0) {
+        /* Older than everything held, so it goes straight out */
+        m->source[source].chosen++;
+        m->out_source = source;
+        m->last_ms    = fix->time_ms;
+        m->started    = 1;
+        if(m->out)
+          m->out(m->user, fix);
+        return;
+      }
+      pass_on_oldest(m);
+      n--;
+    }
+    for(k = m->count; k > n; k--)
+      m->slot[(m->head + k) & SLOT_MASK] = m->slot[(m->head + k-1) & SLOT_MASK];
+    e = &m->slot[(m->head + n) & SLOT_MASK];
+    e->sources = 1u << source;
+    e->best    = source;
+    e->fix     = *fix;
+    m->count++;
+  }
+
+  /* Every source has given this epoch, so it and any before it are done */
+  if(e->sources == (1u << m->nsources) - 1) {
+    for(k = 0; k <= n; k++)
+      pass_on_oldest(m);
+  }
+
+  /* Then anything that has waited for longer than the window */
+  while(m->count > 0 && time_diff(m->slot[m->head].fix.time_ms, fix->time_ms) > (int)m->window_ms)
+    pass_on_oldest(m);
+}
+
+/****************************************************************************/
+void gps_merge_fix_callback(void *source, const gps_fix_t *fix) {
+  gps_merge_source_t *s = source;
+  gps_merge_add(s->merge, s->index, fix);
+}
+
+/****************************************************************************/
+void gps_merge_flush(gps_merge_t *m) {
+  while(m->count > 0)
+    pass_on_oldest(m);
+}
+/************************ End of file  ***************************************/
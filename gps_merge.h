@@ -0,0 +1,105 @@
+/******************************************************************************
+* gps_merge.h - one stream of fixes from redundant receivers
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef GPS_MERGE_H
+#define GPS_MERGE_H
+#include "gps_parse.h"
+
+/****************************************************************************
+* Merges the fixes from several receivers on the same vehicle into one
+* stream in time order, with one fix per epoch: the best one any receiver
+* gave for that time. Best is a position over none, then the better
+* fix_quality (RTK fixed, RTK float, differential, GPS), then more
+* satellites, then the lower hor_dop. The chosen fix is passed on whole,
+* never pieced together from several receivers.
+*
+* Each epoch is held until every source has given its fix for that time,
+* or until a fix window_ms newer arrives, so a receiver that is slow or has
+* lost its fix delays the stream by at most the window. Fixes for a time
+* already passed on are late and dropped. At most GPS_MERGE_SLOTS epochs
+* are held, so the work per fix is bounded, and nothing is allocated.
+*
+* Times are fix time of day (time_ms) and are compared across midnight.
+* Fixes without a time are dropped. All the parsers feeding a merge must
+* be run from the same thread.
+****************************************************************************/
+#define GPS_MERGE_MAX_SOURCES 8
+#define GPS_MERGE_SLOTS       16      /* a power of two */
+
+struct gps_merge;
+
+typedef struct gps_merge_source {
+  struct gps_merge *merge;
+  unsigned          index;
+  unsigned long     fixes;    /* fixes given */
+  unsigned long     chosen;   /* fixes passed on */
+} gps_merge_source_t;
+
+typedef struct gps_merge_epoch {
+  unsigned  sources;          /* bit n set once source n has given a fix */
+  unsigned  best;             /* source of fix */
+  gps_fix_t fix;
+} gps_merge_epoch_t;
+
+typedef struct gps_merge {
+  unsigned  nsources;
+  unsigned  window_ms;
+  gps_fix_callback_func out;
+  void     *user;
+  unsigned  out_source;       /* source of the fix being passed on */
+
+  /* Epochs being held, oldest at slot[head] */
+  gps_merge_epoch_t slot[GPS_MERGE_SLOTS];
+  unsigned  head;
+  unsigned  count;
+  unsigned  last_ms;          /* time of the last fix passed on */
+  int       started;
+
+  unsigned long late;         /* fixes for an epoch already passed on */
+  unsigned long overflow;     /* epochs passed on early because all slots were full */
+  unsigned long untimed;      /* fixes without a time */
+  gps_merge_source_t source[GPS_MERGE_MAX_SOURCES];
+} gps_merge_t;
+
+/* out gets each merged fix, with user. Returns 0 if sources is 0 or more
+   than GPS_MERGE_MAX_SOURCES */
+int  gps_merge_init(gps_merge_t *m, unsigned sources, unsigned window_ms,
+                    gps_fix_callback_func out, void *user);
+
+/* Adds a fix from one source */
+void gps_merge_add(gps_merge_t *m, unsigned source, const gps_fix_t *fix);
+
+/* A gps_fix_callback_func for a parser whose user pointer is
+   &m->source[n], the nth source */
+void gps_merge_fix_callback(void *source, const gps_fix_t *fix);
+
+/* Passes on every epoch still held, at the end of the input */
+void gps_merge_flush(gps_merge_t *m);
+#endif
+/************************ End of file  ***************************************/
@@ -28,461 +28,1371 @@
 * SOFTWARE.
 ******************************************************************************/
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define GPS_HAVE_RDTSC
+#endif
 #include "gps_parse.h"
+#include "gps_batch.h"
 
-static enum {
-	state_wait_for_nl,
-	state_should_be_dollar,
-	state_should_be_NMEA,
-	state_checksum1,
-	state_checksum2,
-	state_should_be_nl
-} state = state_wait_for_nl;
-
-static char checksum = 0;
-static char synced = 0;
-#define BUFFER_SIZE 128
-static int  buffer_used = 0;
-static char buffer[BUFFER_SIZE];
-
-static gps_GPGGA_callback_func  GPGGA_callback;
-static gps_GPRMC_callback_func  GPRMC_callback;
-static gps_GPVTG_callback_func  GPVTG_callback;
-static gps_GPGLL_callback_func  GPGLL_callback;
-static gps_reject_callback_func reject_callback;
-static gps_no_fix_callback_func no_fix_callback;
-
-/****************************************************************************/
-static void reject(char *msg, char *buffer) {
-  if(reject_callback != NULL) 
-    reject_callback(msg, buffer);
-}
-/****************************************************************************/
-static int sentence_type(char *header) {
-  int i = 0;
-  while(header[i] != '\0') {
-    if(header[i] != buffer[i])
-      return 0;
-    i++;
-  }
+static gps_parser_t default_parser;
+static int          default_parser_ready = 0;
 
-  if(buffer[i] != ',')
-    return 0;
-  /* Match */
-  return 1;
+/****************************************************************************/
+static char *reject_messages[GPS_REJECT_REASONS] = {
+  "Invalid checksum",
+  "NMEA sentence too long",
+  "Too many fields",
+  "Unknown sentence",
+  "Parse error"
+};
+
+static void reject(gps_parser_t *p, enum gps_reject_reason reason, char *buffer) {
+  p->stats.rejected[reason]++;
+  if(p->reject_callback != NULL) 
+    p->reject_callback(p->user, reject_messages[reason], buffer);
 }
+
+#define GPS_ENABLE_POSITION (GPS_ENABLE_GGA || GPS_ENABLE_RMC || GPS_ENABLE_GLL)
+
+#if GPS_ENABLE_POSITION || GPS_ENABLE_VTG || GPS_ENABLE_GSA || GPS_ENABLE_GSV
 /****************************************************************************/
-static int field_present(int fieldno) {
-  int i = 0;
-  while(fieldno > 0) {
-    if(buffer[i] == '\0') return 0;
-    if(buffer[i] == ',') fieldno--;
-    i++;
+static void get_talker(const gps_sentence_t *s, char *talker) {
+  /* Proprietary sentences have no talker */
+  if(s->start[1] == 6 && s->text[0] != 'P') {
+    talker[0] = s->text[0];
+    talker[1] = s->text[1];
+    talker[2] = '\0';
+  } else {
+    talker[0] = '\0';
   }
-  if(buffer[i] == ',')  return 0;
-  if(buffer[i] == '\0') return 0;
-  return 1;
 }
+#endif
+
+#if GPS_ENABLE_POSITION
+/****************************************************************************/
+/* Read a latitude/longitude and its hemisphere, making south and west      */
+/* negative. The unsigned value and hemisphere are also kept for the        */
+/* original callbacks                                                       */
 /****************************************************************************/
-static int parse_char(int fieldno, char *dest, char*acceptible) {
-  int i = 0;
-  while(fieldno > 0) {
-    if(buffer[i] == '\0') return 0;
-    if(buffer[i] == ',') fieldno--;
-    i++;
+static int parse_position(const gps_sentence_t *s, int fieldno, char *hemispheres,
+                          double *value, char *hemisphere, double *deg, int64_t *ndeg) {
+  if(!gps_field_angle_fixed(s, fieldno,   ndeg, value)) return 0;
+  if(!gps_field_char(       s, fieldno+1, hemisphere, hemispheres)) return 0;
+  if(hemispheres[0] == 'N' && *ndeg > GPS_MAX_LATITUDE_NDEG) return 0;
+  *deg = *value;
+  if(*hemisphere == hemispheres[1]) {
+    *deg  = -*deg;
+    *ndeg = -*ndeg;
   }
+  return 1;
+}
+#endif
 
-  /* Look for match */
-  while(*acceptible != '\0' && *acceptible != buffer[i]) 
-     acceptible++;
+#if GPS_ENABLE_POSITION || GPS_ENABLE_UBX
+/****************************************************************************/
+/* UTC. The date of the last RMC or NAV-PVT gives the day, which moves on   */
+/* when the time of day goes back by more than 12 hours (midnight has been  */
+/* passed before the next date arrives). A time more than 12 hours ahead is */
+/* a late sentence from the day before.                                     */
+/****************************************************************************/
+#define HALF_DAY_MS 43200000u
 
-  /* Check a match was found */
-  if(*acceptible == '\0') return 0;
+#if GPS_ENABLE_RMC || GPS_ENABLE_UBX
+static void utc_date(gps_parser_t *p, int64_t days, unsigned time_ms) {
+  p->utc_day    = days;
+  p->utc_day_ms = time_ms;
+  p->utc_known  = 1;
+}
+#endif
 
-  /* Check that field is correctly terminated */
-  if(buffer[i+1] != ',' && buffer[i+1] != '\0') return 0;
+#if GPS_ENABLE_POSITION
+static int64_t utc_ns(gps_parser_t *p, unsigned time_ms) {
+  int64_t day = p->utc_day;
 
-  *dest = buffer[i];
-  return 1;
+  if(!p->utc_known) return 0;
+  if(time_ms + HALF_DAY_MS < p->utc_day_ms) {
+    p->utc_day    = ++day;
+    p->utc_day_ms = time_ms;
+  } else if(time_ms > p->utc_day_ms + HALF_DAY_MS) {
+    day--;
+  } else if(time_ms > p->utc_day_ms) {
+    p->utc_day_ms = time_ms;
+  }
+  return (day * 86400000 + time_ms) * 1000000;
 }
+#endif
+#endif
 
+#if GPS_ENABLE_RMC
 /****************************************************************************/
-static int parse_uint(int fieldno, unsigned *dest) {
-  unsigned i = 0;
-  unsigned value = 0;
-  while(fieldno > 0) {
-    if(buffer[i] == '\0') return 0;
-    if(buffer[i] == ',') fieldno--;
-    i++;
-  }
+/* Days since 1970 of a ddmmyy date. Two digit years are 1980 to 2079, and  */
+/* dates before p->earliest_utc are moved on by whole 1024 week rollovers   */
+/****************************************************************************/
+#define ROLLOVER_DAYS (1024*7)
 
-  while(buffer[i] >= '0' && buffer[i] <= '9') {
-    value = value*10 + buffer[i]-'0';
-    i++;
-  }
-  /* Check that field is correctly terminated */
-  if(buffer[i] != ',' && buffer[i] != '\0') return 0;
+static int64_t date_days(const gps_parser_t *p, unsigned date) {
+  unsigned yy       = date % 100;
+  int64_t  days     = gps_utc_days(yy < 80 ? 2000+yy : 1900+yy, date/100%100, date/10000);
+  int64_t  earliest = p->earliest_utc / 86400;
 
-  *dest = value;
-  return 1;
+  if(days < earliest)
+    days += (earliest - days + ROLLOVER_DAYS-1) / ROLLOVER_DAYS * ROLLOVER_DAYS;
+  return days;
 }
+#endif
 
 /****************************************************************************/
-static int parse_double(int fieldno, double *dest) {
-  unsigned i = 0;
-  double value = 0;
-  int decimals = 0;
-  while(fieldno > 0) {
-    if(buffer[i] == '\0') return 0;
-    if(buffer[i] == ',') fieldno--;
-    i++;
-  }
+/* The epoch aggregator. Sentences are merged into p->fix until one with a  */
+/* different time arrives, then the finished fix is handed over. VTG and    */
+/* GSA carry no time, so they belong to whatever epoch is open. A sentence  */
+/* saying the fix is lost also closes the epoch, and VTG and GSA sent       */
+/* without a fix are not merged into anything.                              */
+/****************************************************************************/
+#define AGGREGATING(p) ((p)->fix_callback != NULL || (p)->batch != NULL)
 
-  while(buffer[i] >= '0' && buffer[i] <= '9') {
-    value = value*10 + buffer[i]-'0';
-    i++;
-  }
-  if(buffer[i] == '.') {
-    i++;
-    while(buffer[i] >= '0' && buffer[i] <= '9') {
-      value = value*10 + buffer[i]-'0';
-      i++;
-      decimals++;
-    }
+#define TRACKING_FIX(p) ((p)->no_fix_callback != NULL || (p)->fix_acquired_callback != NULL)
+
+/****************************************************************************/
+/* Whether anything will see the result of decoding a type of sentence, so  */
+/* the ones nothing is set to receive are dropped before their fields are   */
+/* read                                                                     */
+/****************************************************************************/
+static int decoding(const gps_parser_t *p, enum gps_sentence_type type) {
+  switch(type) {
+    case GPS_SENTENCE_GGA: return p->GPGGA_callback || p->GGA_callback || AGGREGATING(p) || TRACKING_FIX(p);
+    case GPS_SENTENCE_RMC: return p->GPRMC_callback || p->RMC_callback || AGGREGATING(p) || TRACKING_FIX(p);
+    case GPS_SENTENCE_GLL: return p->GPGLL_callback || p->GLL_callback || AGGREGATING(p) || TRACKING_FIX(p);
+    case GPS_SENTENCE_VTG: return p->GPVTG_callback || p->VTG_callback || AGGREGATING(p);
+    case GPS_SENTENCE_GSA: return p->GSA_callback   || AGGREGATING(p);
+    case GPS_SENTENCE_GSV: return p->GSV_callback   != NULL;
+    default:               return 1;
   }
-  while(decimals > 0) {
-    decimals--;
-    value /= 10.0;
+}
+
+/****************************************************************************/
+/* Fix state. GGA, RMC and GLL say whether there is a fix in a status field */
+/* that is checked before anything else, so during an outage no numbers are */
+/* decoded at all. A fix is only taken as acquired once a sentence with an  */
+/* explicit valid status has been decoded without error. The callbacks are  */
+/* made only when the state changes.                                        */
+/****************************************************************************/
+
+#if GPS_ENABLE_POSITION || GPS_ENABLE_UBX
+static void fix_state(gps_parser_t *p, int have_fix) {
+  enum gps_fix_state state = have_fix ? gps_fix_state_fix : gps_fix_state_none;
+
+  if(state == p->fix_state) return;
+  p->fix_state = state;
+  if(have_fix) {
+    if(p->fix_acquired_callback)
+      p->fix_acquired_callback(p->user);
+  } else if(p->no_fix_callback) {
+    p->no_fix_callback(p->user);
   }
-  /* Check that field is correctly terminated */
-  if(buffer[i] != ',' && buffer[i] != '\0') return 0;
+}
+#endif
 
-  *dest = value;
+#if GPS_ENABLE_POSITION
+/****************************************************************************/
+/* The epoch open when the fix is lost is finished, so it is handed over    */
+/* now rather than when the fix comes back                                  */
+/****************************************************************************/
+static int no_fix(gps_parser_t *p) {
+  p->stats.no_fix++;
+  fix_state(p, 0);
+  gps_parser_flush(p);
   return 1;
 }
 
 /****************************************************************************/
-static int parse_angle(int fieldno, double *dest) {
-  unsigned i = 0;
-  unsigned degrees = 0;
-  double   minutes = 0;
-  int      decimals = 0;
-  int      sign;
+/* Whether a field is exactly the one character c                           */
+/****************************************************************************/
+static int field_is(const gps_sentence_t *s, int fieldno, char c) {
+  unsigned    len;
+  const char *f = gps_field(s, fieldno, &len);
+  return f != NULL && len == 1 && *f == c;
+}
+#endif
 
-  while(fieldno > 0) {
-    if(buffer[i] == '\0') return 0;
-    if(buffer[i] == ',') fieldno--;
-    i++;
+#if GPS_ENABLE_POSITION || GPS_ENABLE_UBX
+static void fix_epoch(gps_parser_t *p, unsigned time_ms, int64_t utc_ns) {
+  /* Untimed sentences with no epoch open belong to one whose start was
+     never seen, so they go on as a fix of their own rather than being
+     merged into this one */
+  if(p->fix.have != 0 && (!(p->fix.have & GPS_FIX_TIME) || p->fix.time_ms != time_ms))
+    gps_parser_flush(p);
+  if(!(p->fix.have & GPS_FIX_TIME))
+    p->fix.rx_ns = p->rx_ns;
+  if(utc_ns != 0) {
+    p->fix.utc_ns = utc_ns;
+    p->fix.have  |= GPS_FIX_UTC;
   }
+  p->fix.time_ms = time_ms;
+  p->fix.have   |= GPS_FIX_TIME;
+}
 
-  if(buffer[i] == '-') {
-    sign = -1;
-    i++;
-  } else {
-    sign = 1;
-  }
+/****************************************************************************/
+static void fix_position(gps_parser_t *p, const char *talker, int64_t latitude_ndeg, int64_t longitude_ndeg,
+                         double latitude, double longitude) {
+  memcpy(p->fix.talker, talker, sizeof(p->fix.talker));
+  p->fix.latitude_ndeg  = latitude_ndeg;
+  p->fix.longitude_ndeg = longitude_ndeg;
+  p->fix.latitude       = latitude;
+  p->fix.longitude      = longitude;
+  p->fix.have          |= GPS_FIX_POSITION;
+}
+#endif
+
+#if GPS_ENABLE_GGA
+/****************************************************************************/
+static void fix_add_GGA(gps_parser_t *p, const gps_GGA_t *gga) {
+  fix_epoch(p, gga->time_ms, gga->utc_ns);
+  fix_position(p, gga->talker, gga->latitude_ndeg, gga->longitude_ndeg, gga->latitude, gga->longitude);
+  p->fix.altitude    = gga->altitude;
+  p->fix.hor_dop     = gga->hor_dop;
+  p->fix.fix_quality = gga->fix_quality;
+  p->fix.no_of_sats  = gga->no_of_sats;
+  p->fix.have       |= GPS_FIX_ALTITUDE | GPS_FIX_QUALITY;
+}
+
+#endif
+#if GPS_ENABLE_RMC
+/****************************************************************************/
+static void fix_add_RMC(gps_parser_t *p, const gps_RMC_t *rmc) {
+  fix_epoch(p, rmc->time_ms, rmc->utc_ns);
+  fix_position(p, rmc->talker, rmc->latitude_ndeg, rmc->longitude_ndeg, rmc->latitude, rmc->longitude);
+  p->fix.date        = rmc->date;
+  p->fix.speed_knots = rmc->speed_knots;
+  p->fix.course      = rmc->course;
+  p->fix.have       |= GPS_FIX_DATE | GPS_FIX_VELOCITY;
+}
 
-  while(buffer[i] >= '0' && buffer[i] <= '9') {
-    degrees = degrees*10 + buffer[i]-'0';
-    i++;
+#endif
+#if GPS_ENABLE_GLL
+/****************************************************************************/
+static void fix_add_GLL(gps_parser_t *p, const gps_GLL_t *gll) {
+  fix_epoch(p, gll->time_ms, gll->utc_ns);
+  fix_position(p, gll->talker, gll->latitude_ndeg, gll->longitude_ndeg, gll->latitude, gll->longitude);
+}
+
+#endif
+#if GPS_ENABLE_VTG
+/****************************************************************************/
+static void fix_add_VTG(gps_parser_t *p, const gps_VTG_t *vtg) {
+  if((vtg->valid & GPS_VTG_SPEED_KNOTS) && (vtg->valid & GPS_VTG_COURSE_TRUE)) {
+    p->fix.speed_knots = vtg->speed_knots;
+    p->fix.course      = vtg->course_true;
+    p->fix.have       |= GPS_FIX_VELOCITY;
   }
+}
 
-  minutes  = degrees%100;
-  degrees /= 100;
+#endif
+#if GPS_ENABLE_UBX
+/****************************************************************************/
+/* NAV-PVT is a whole epoch in itself, but NMEA for the same time can be   */
+/* merged with it, so only what it has is written                           */
+/****************************************************************************/
+static void fix_add_PVT(gps_parser_t *p, const gps_NAV_PVT_t *pvt) {
+  gps_fix_t f;
 
-  if(buffer[i] == '.') {
-    i++;
-    while(buffer[i] >= '0' && buffer[i] <= '9') {
-      minutes = minutes*10 + buffer[i]-'0';
-      i++;
-      decimals++;
-    }
+  gps_ubx_PVT_fix(pvt, &f);
+  if(!(f.have & GPS_FIX_TIME)) return;
+  fix_epoch(p, f.time_ms, f.utc_ns);
+  if(f.have & GPS_FIX_POSITION)
+    fix_position(p, f.talker, f.latitude_ndeg, f.longitude_ndeg, f.latitude, f.longitude);
+  if(f.have & GPS_FIX_ALTITUDE)
+    p->fix.altitude = f.altitude;
+  if(f.have & GPS_FIX_VELOCITY) {
+    p->fix.speed_knots = f.speed_knots;
+    p->fix.course      = f.course;
   }
-  while(decimals > 0) {
-    decimals--;
-    minutes /= 10.0;
+  if(f.have & GPS_FIX_QUALITY) {
+    p->fix.fix_quality = f.fix_quality;
+    p->fix.no_of_sats  = f.no_of_sats;
   }
+  if(f.have & GPS_FIX_DATE)
+    p->fix.date = f.date;
+  p->fix.fix_type = f.fix_type;
+  p->fix.pos_dop  = f.pos_dop;
+  p->fix.have    |= f.have;
+}
+#endif
+#if GPS_ENABLE_GSA
+/****************************************************************************/
+static void fix_add_GSA(gps_parser_t *p, const gps_GSA_t *gsa) {
+  p->fix.fix_type = gsa->fix_type;
+  p->fix.pos_dop  = gsa->pos_dop;
+  p->fix.hor_dop  = gsa->hor_dop;
+  p->fix.vert_dop = gsa->vert_dop;
+  p->fix.have    |= GPS_FIX_DOP;
+}
 
-  /* Check that field is correctly terminated */
-  if(buffer[i] != ',' && buffer[i] != '\0') return 0;
-
-  minutes /=60;
-  *dest = degrees+minutes;
-  if(sign < 0)
-    *dest = -*dest;
-  return 1;
+#endif
+/****************************************************************************/
+void gps_parser_flush(gps_parser_t *p) {
+  if(p->fix.have != 0) {
+    if(p->fix_callback)
+      p->fix_callback(p->user, &p->fix);
+    /* Hand back control once the batch is full. gps_batch_add() counts
+       the fixes that find it already full */
+    if(p->batch) {
+      gps_batch_add(p->batch, &p->fix);
+      if(p->batch->count == p->batch->capacity)
+        p->stop = 1;
+    }
+  }
+  memset(&p->fix, 0, sizeof(p->fix));
 }
 
+#if GPS_ENABLE_GGA
 /****************************************************************************/
-static int parse_GPGGA(void) {
-  unsigned fix_quality = 0;
-  unsigned no_of_sats = 0;
-  double   timestamp = 0;
-  double   latitude = 0;
-  char     latitude_ns = 'N';
-  double   longitude = 0;
-  char     longitude_ew = 'E';
-  double   altitude = 0;
-  char     alt_units = 0;
-  double   hor_dop = 0;
-
-  if(!parse_double( 1, &timestamp         )) return 0;
-  if(!field_present(2)) return 1;
-  if(!parse_angle(  2, &latitude          )) return 0;
-  if(!parse_char(   3, &latitude_ns,  "NS")) return 0;
-  if(!parse_angle(  4, &longitude         )) return 0;
-  if(!parse_char(   5, &longitude_ew, "EW")) return 0;
-  if(!parse_uint(   6, &fix_quality       )) return 0;
-  if(!parse_uint(   7, &no_of_sats        )) return 0;
-  if(!parse_double( 8, &hor_dop           )) return 0;
-  if(!parse_double( 9, &altitude          )) return 0;
-  if(!parse_char(  10, &alt_units,     "M")) return 0;
-
-
-  if(GPGGA_callback) {
-    GPGGA_callback(fix_quality, no_of_sats,  timestamp,
-                   latitude,    latitude_ns, longitude, longitude_ew,
-                   altitude,    alt_units,   hor_dop);
+static int parse_GPGGA(gps_parser_t *p, const gps_sentence_t *s) {
+  gps_GGA_t gga;
+  double    latitude = 0;
+  char      latitude_ns = 'N';
+  double    longitude = 0;
+  char      longitude_ew = 'E';
+  char      alt_units = 0;
+  int64_t   altitude_mm = 0;
+
+  /* No position, or a fix quality of 0 */
+  if(!gps_field_present(s, GPS_GGA_LATITUDE) || field_is(s, GPS_GGA_FIX_QUALITY, '0'))
+    return no_fix(p);
+
+  memset(&gga, 0, sizeof(gga));
+  get_talker(s, gga.talker);
+
+  if(!gps_field_time(   s, 1, &gga.time_ms, &gga.timestamp)) return 0;
+  if(!parse_position(   s, 2, "NS", &latitude,  &latitude_ns,  &gga.latitude,  &gga.latitude_ndeg))  return 0;
+  if(!parse_position(   s, 4, "EW", &longitude, &longitude_ew, &gga.longitude, &gga.longitude_ndeg)) return 0;
+  if(!gps_field_uint(   s, 6, &gga.fix_quality                 )) return 0;
+  if(!gps_field_uint(   s, 7, &gga.no_of_sats                  )) return 0;
+  if(!gps_field_double( s, 8, &gga.hor_dop                     )) return 0;
+  if(!gps_field_scaled( s, 9, 3, &altitude_mm, &gga.altitude   )) return 0;
+  if(!gps_field_char(   s,10, &alt_units,                  "M" )) return 0;
+  if(altitude_mm > INT32_MAX || altitude_mm < -INT32_MAX) return 0;
+  gga.altitude_mm = (int32_t)altitude_mm;
+  gga.utc_ns      = utc_ns(p, gga.time_ms);
+  gga.rx_ns       = p->rx_ns;
+  if(gga.fix_quality > 0)
+    fix_state(p, 1);
+
+  if(p->GPGGA_callback) {
+    p->GPGGA_callback(p->user, gga.fix_quality, gga.no_of_sats,  gga.timestamp,
+                   latitude,     latitude_ns, longitude, longitude_ew,
+                   gga.altitude, alt_units,   gga.hor_dop);
   }
+  if(p->GGA_callback)
+    p->GGA_callback(p->user, &gga);
+  if(AGGREGATING(p))
+    fix_add_GGA(p, &gga);
   return 1;
 }
 
+#endif
+#if GPS_ENABLE_RMC
+/****************************************************************************/
+static int parse_GPRMC(gps_parser_t *p, const gps_sentence_t *s) { 
+  gps_RMC_t rmc;
+  double    latitude     = 0.0;
+  char      latitude_ns  = 'N';
+  double    longitude    = 0.0;
+  char      longitude_ew = 'E';
+  double    date_of_fix  = 0.0;
+
+  /* Status V, or an NMEA 2.3 mode of N */
+  if(field_is(s, GPS_RMC_STATUS, 'V') || field_is(s, GPS_RMC_MODE, 'N'))
+    return no_fix(p);
+
+  memset(&rmc, 0, sizeof(rmc));
+  get_talker(s, rmc.talker);
+
+  if(!gps_field_time(  s, 1, &rmc.time_ms, &rmc.timestamp)) return 0;
+  if(!gps_field_char(  s, 2, &rmc.nav_warning,          "A")) return 0;
+  if(!parse_position(  s, 3, "NS", &latitude,  &latitude_ns,  &rmc.latitude,  &rmc.latitude_ndeg))  return 0;
+  if(!parse_position(  s, 5, "EW", &longitude, &longitude_ew, &rmc.longitude, &rmc.longitude_ndeg)) return 0;
+  if(!gps_field_double(s, 7, &rmc.speed_knots               )) return 0;
+  if(!gps_field_double(s, 8, &rmc.course                    )) return 0;
+  if(!gps_field_double(s, 9, &date_of_fix                   )) return 0;
+  if(date_of_fix < 0 || date_of_fix >= 1000000) return 0;
+  rmc.date = (unsigned)date_of_fix;
+  /* ddmmyy, or 0 when the receiver doesn't know it yet */
+  if(rmc.date != 0 && (rmc.date / 10000 < 1 || rmc.date / 10000 > 31
+                       || rmc.date / 100 % 100 < 1 || rmc.date / 100 % 100 > 12)) return 0;
+  if(rmc.date != 0)
+    utc_date(p, date_days(p, rmc.date), rmc.time_ms);
+  rmc.utc_ns = utc_ns(p, rmc.time_ms);
+  rmc.rx_ns  = p->rx_ns;
+  if(field_is(s, GPS_RMC_STATUS, 'A'))
+    fix_state(p, 1);
+
+  if(p->GPRMC_callback) 
+     p->GPRMC_callback(p->user, rmc.timestamp,   date_of_fix, rmc.nav_warning,
+                    latitude,        latitude_ns, longitude,   longitude_ew,
+                    rmc.speed_knots, rmc.course);
+  if(p->RMC_callback)
+    p->RMC_callback(p->user, &rmc);
+  if(AGGREGATING(p))
+    fix_add_RMC(p, &rmc);
+  return 1;
+}
+#endif
+#if GPS_ENABLE_GLL
 /****************************************************************************/
-static int parse_GPRMC(void) { 
-  double   timestamp    = 0.0;
-  double   date_of_fix  = 0.0;
-  char     nav_warning  = 'A';
-  double   latitude     = 0.0;
-  char     latitude_ns  = 'N';
-  double   longitude    = 0.0;
-  char     longitude_ew = 'E';
-  double   speed_knots  = 0.0;
-  double   course       = 0.0;
+static int parse_GPGLL(gps_parser_t *p, const gps_sentence_t *s) {
+  gps_GLL_t gll;
+  double    latitude     = 0;
+  char      latitude_ns  = 'N';
+  double    longitude    = 0;
+  char      longitude_ew = 'E';
 
+  if(field_is(s, GPS_GLL_STATUS, 'V') || field_is(s, GPS_GLL_MODE, 'N'))
+    return no_fix(p);
 
-  if(!parse_double( 1, &timestamp        )) return 0;
-  if(!parse_char(   2, &nav_warning, "AV")) return 0;
-  if(nav_warning == 'V') return 1;
-  if(!parse_angle(  3, &latitude         )) return 0;
-  if(!parse_char(   4, &latitude_ns, "NS")) return 0;
-  if(!parse_angle(  5, &longitude        )) return 0;
-  if(!parse_char(   6, &longitude_ew,"EW")) return 0;
-  if(!parse_double( 7, &speed_knots      )) return 0;
-  if(!parse_double( 8, &course           )) return 0;
-  if(!parse_double( 9, &date_of_fix      )) return 0;
+  memset(&gll, 0, sizeof(gll));
+  get_talker(s, gll.talker);
 
-  if(GPRMC_callback) 
-     GPRMC_callback(timestamp,   date_of_fix, nav_warning,
-                    latitude,    latitude_ns, longitude,   longitude_ew,
-                    speed_knots, course);
+  if(!parse_position(s, 1, "NS", &latitude,  &latitude_ns,  &gll.latitude,  &gll.latitude_ndeg))  return 0;
+  if(!parse_position(s, 3, "EW", &longitude, &longitude_ew, &gll.longitude, &gll.longitude_ndeg)) return 0;
+  if(!gps_field_time(s, 5, &gll.time_ms, &gll.timestamp)) return 0;
+  gll.utc_ns = utc_ns(p, gll.time_ms);
+  gll.rx_ns  = p->rx_ns;
+  if(field_is(s, GPS_GLL_STATUS, 'A'))
+    fix_state(p, 1);
 
+  if(p->GPGLL_callback)
+	p->GPGLL_callback(p->user, gll.timestamp, latitude, latitude_ns, longitude, longitude_ew);
+  if(p->GLL_callback)
+    p->GLL_callback(p->user, &gll);
+  if(AGGREGATING(p))
+    fix_add_GLL(p, &gll);
   return 1;
 }
+
+#endif
+#if GPS_ENABLE_GSA
 /****************************************************************************/
-static int parse_GPGLL(void) {
-  double   timestamp    = 0.0;
-  double   latitude     = 0;
-  char     latitude_ns  = 'N';
-  double   longitude    = 0;
-  char     longitude_ew = 'E';
+static int parse_GPGSA(gps_parser_t *p, const gps_sentence_t *s) {
+  gps_GSA_t gsa;
+  int       i;
+
+  memset(&gsa, 0, sizeof(gsa));
+  get_talker(s, gsa.talker);
 
-  if(!parse_angle(  1, &latitude         )) return 0;
-  if(!parse_char(   2, &latitude_ns, "NS")) return 0;
-  if(!parse_angle(  3, &longitude        )) return 0;
-  if(!parse_char(   4, &longitude_ew,"EW")) return 0;
-  if(!parse_double( 5, &timestamp        )) return 0;
+  if(!gps_field_char(  s, 1, &gsa.mode,   "AM")) return 0;
+  if(!gps_field_uint(  s, 2, &gsa.fix_type    )) return 0;
+  /* Up to 12 PRNs in fields 3 to 14, empty ones unused */
+  for(i = 3; i <= 14; i++) {
+    unsigned prn;
+    if(!gps_field_present(s, i)) continue;
+    if(!gps_field_uint(s, i, &prn)) return 0;
+    gsa.prn[gsa.no_of_prns++] = prn;
+  }
+  if(!gps_field_double(s, 15, &gsa.pos_dop    )) return 0;
+  if(!gps_field_double(s, 16, &gsa.hor_dop    )) return 0;
+  if(!gps_field_double(s, 17, &gsa.vert_dop   )) return 0;
 
-  if(GPGLL_callback)
-	GPGLL_callback(timestamp, latitude, latitude_ns, longitude, longitude_ew);
+  if(p->GSA_callback)
+    p->GSA_callback(p->user, &gsa);
+  if(AGGREGATING(p) && p->fix_state != gps_fix_state_none)
+    fix_add_GSA(p, &gsa);
   return 1;
 }
 
+#endif
+#if GPS_ENABLE_GSV
 /****************************************************************************/
-static int parse_GPGSA(void) {
+static int parse_sat_value(const gps_sentence_t *s, int fieldno, short *dest) {
+  unsigned value;
+  if(!gps_field_present(s, fieldno)) {
+    *dest = -1;
+    return 1;
+  }
+  if(!gps_field_uint(s, fieldno, &value) || value > 360) return 0;
+  *dest = (short)value;
   return 1;
 }
 
 /****************************************************************************/
-static int parse_GPGSV(void) {
+/* GSV comes as a numbered sequence of sentences with four satellites each. */
+/* They are collected in place in p->sky, and the callback is made once the */
+/* last one arrives. A sequence that breaks off part way is dropped.        */
+/****************************************************************************/
+static int parse_GPGSV(gps_parser_t *p, const gps_sentence_t *s) {
+  gps_sky_t *sky = &p->sky;
+  char       talker[3];
+  unsigned   total, number, in_view;
+  int        i;
+
+  if(!gps_field_uint(s, 1, &total  )) return 0;
+  if(!gps_field_uint(s, 2, &number )) return 0;
+  if(!gps_field_uint(s, 3, &in_view)) return 0;
+  if(number < 1 || number > total) return 0;
+  get_talker(s, talker);
+
+  if(number == 1) {
+    memcpy(sky->talker, talker, sizeof(sky->talker));
+    sky->sats_in_view = in_view;
+    sky->count        = 0;
+    p->sky_total      = total;
+    p->sky_next       = 1;
+  }
+
+  /* Not the part we were expecting - wait for the start of the next set */
+  if(number != p->sky_next || total != p->sky_total
+     || memcmp(talker, sky->talker, sizeof(talker)) != 0) {
+    p->sky_next = 0;
+    return 1;
+  }
+
+  /* Groups of PRN, elevation, azimuth and SNR. NMEA 4.1 adds a signal ID
+     at the end, which the i+3 < fields test skips over */
+  for(i = 4; i+3 < (int)s->fields; i += 4) {
+    gps_sat_t *sat;
+    unsigned   prn;
+
+    if(!gps_field_present(s, i)) continue;
+    if(!gps_field_uint(s, i, &prn) || prn > 0xFFFF) return 0;
+    if(sky->count == GPS_MAX_SATS) break;
+
+    sat = &sky->sat[sky->count];
+    sat->prn = (unsigned short)prn;
+    if(!parse_sat_value(s, i+1, &sat->elevation)) return 0;
+    if(!parse_sat_value(s, i+2, &sat->azimuth  )) return 0;
+    if(!parse_sat_value(s, i+3, &sat->snr      )) return 0;
+    sky->count++;
+  }
+
+  if(number < total) {
+    p->sky_next++;
+    return 1;
+  }
+
+  p->sky_next = 0;
+  if(p->GSV_callback)
+    p->GSV_callback(p->user, sky);
   return 1;
 }
 
+#endif
+#if GPS_ENABLE_VTG
 /****************************************************************************/
-static int parse_GPVTG(void) {
+static int parse_GPVTG(gps_parser_t *p, const gps_sentence_t *s) {
+  gps_VTG_t vtg;
   double value = 0;
   char   ref   = 'X';
   int i;
+
+  memset(&vtg, 0, sizeof(vtg));
+  get_talker(s, vtg.talker);
+
   i = 1;
   while(1) {
-    if(!parse_double(  i, &value        )) return 1;
-    if(!parse_char(  i+1, &ref,   "TMNK")) return 0;
-    if(GPVTG_callback) {
-      GPVTG_callback(value,ref);
+    if(!gps_field_double(s,  i, &value        )) break;
+    if(!gps_field_char(s,  i+1, &ref,   "TMNK")) return 0;
+    if(p->GPVTG_callback) {
+      p->GPVTG_callback(p->user, value,ref);
+    }
+    /* Receivers send empty values when they don't know */
+    if(gps_field_present(s, i)) switch(ref) {
+      case 'T': vtg.course_true     = value; vtg.valid |= GPS_VTG_COURSE_TRUE;     break;
+      case 'M': vtg.course_magnetic = value; vtg.valid |= GPS_VTG_COURSE_MAGNETIC; break;
+      case 'N': vtg.speed_knots     = value; vtg.valid |= GPS_VTG_SPEED_KNOTS;     break;
+      case 'K': vtg.speed_kmh       = value; vtg.valid |= GPS_VTG_SPEED_KMH;       break;
     }
     i += 2;
   }
+  if(p->VTG_callback)
+    p->VTG_callback(p->user, &vtg);
+  if(AGGREGATING(p) && p->fix_state != gps_fix_state_none)
+    fix_add_VTG(p, &vtg);
   return 1;
 }
 
+#endif
 /****************************************************************************/
-static void parse_data(void) {
-  if(sentence_type("GPGGA")) {
-     if(!parse_GPGGA())
-       reject("Parse error",buffer);
-     return;
-  }
+/* Sentence handlers are found through a small open addressed hash table,   */
+/* keyed on the header packed into an integer. A three letter key ("GGA")   */
+/* matches that formatter from any talker, a full header ("GNGGA", "PUBX")  */
+/* matches only itself.                                                     */
+/****************************************************************************/
+static uint64_t header_key(const char *header, unsigned len) {
+  uint64_t key = 0;
+  if(len == 0 || len > 8) return 0;
+  while(len--)
+    key = key<<8 | (unsigned char)*header++;
+  return key;
+}
+
+/****************************************************************************/
+static struct gps_handler *handler_slot(gps_parser_t *p, uint64_t key) {
+  unsigned i = (unsigned)((key * 0x9E3779B97F4A7C15ull) >> 59) & (GPS_HANDLER_SLOTS-1);
+  /* Never more than GPS_MAX_HANDLERS in use, so an empty slot will be found */
+  while(p->handlers[i].key != key && p->handlers[i].key != 0)
+    i = (i+1) & (GPS_HANDLER_SLOTS-1);
+  return &p->handlers[i];
+}
+
+/****************************************************************************/
+static struct gps_handler *find_handler(gps_parser_t *p, const gps_sentence_t *s) {
+  unsigned len = s->start[1] - 1;
+  struct gps_handler *h;
+
+  /* Must have at least one field after the header */
+  if(s->fields < 2) return NULL;
+
+  h = handler_slot(p, header_key(s->text, len));
+  if(h->key != 0 && h->handler != NULL)
+    return h;
+
+  /* Try just the formatter, for any talker. Proprietary sentences don't have one */
+  if(len != 5 || s->text[0] == 'P') return NULL;
+  h = handler_slot(p, header_key(s->text+2, 3));
+  if(h->key != 0 && h->handler != NULL)
+    return h;
+  return NULL;
+}
 
-  if(sentence_type("GPGLL")) {
-     if(!parse_GPGLL())
-       reject("Parse error",buffer);
-     return;
+/****************************************************************************/
+static void parse_data(gps_parser_t *p) {
+  const gps_sentence_t  *s = &p->sentence;
+  struct gps_handler    *h;
+  gps_view_callback_func view;
+
+  p->sentence.text = p->buffer;
+  h = find_handler(p, s);
+  if(h == NULL) {
+    reject(p, GPS_REJECT_UNKNOWN, p->buffer);
+    return;
+  }
+  view = p->view_callback[h->type];
+  if(view)
+    view(p->user, s);
+  if(!decoding(p, h->type)) {
+    if(view)
+      p->stats.accepted[h->type]++;
+    else
+      p->stats.skipped++;
+    return;
   }
 
-  if(sentence_type("GPGSA")) {
-     if(!parse_GPGSA())
-       reject("Parse error",buffer);
-     return;
+  if(!h->handler(p, s)) {
+    reject(p, GPS_REJECT_PARSE, p->buffer);
+    return;
   }
+  p->stats.accepted[h->type]++;
+}
+
+/****************************************************************************/
+/* parse_data(), timed into a log2 histogram of CPU cycles                  */
+/****************************************************************************/
+static uint64_t cycles(void) {
+#ifdef GPS_HAVE_RDTSC
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
 
-  if(sentence_type("GPRMC")) {
-     if(!parse_GPRMC())
-       reject("Parse error",buffer);
-     return;
+static void parse_data_timed(gps_parser_t *p) {
+  uint64_t start = cycles(), taken;
+  unsigned bucket = 0;
+
+  parse_data(p);
+  taken = cycles() - start;
+  while(taken > 1 && bucket < GPS_STATS_BUCKETS-1) {
+    taken >>= 1;
+    bucket++;
   }
+  p->stats.parse_cycles[bucket]++;
+}
 
-  if(sentence_type("GPGSV")) {
-     if(!parse_GPGSV())
-       reject("Parse error",buffer);
-     return;
+#if GPS_ENABLE_UBX
+/****************************************************************************/
+/* UBX frames: 0xB5 0x62, class, id, 16 bit length, payload, then an 8 bit */
+/* Fletcher checksum over everything from the class on                      */
+/****************************************************************************/
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+
+static void ubx_add(gps_parser_t *p, int c) {
+  if(p->ubx_used < sizeof(p->ubx))
+    p->ubx[p->ubx_used] = c;
+  p->ubx_used++;
+  p->ubx_ck_a += c;
+  p->ubx_ck_b += p->ubx_ck_a;
+}
+
+/****************************************************************************/
+static void parse_ubx(gps_parser_t *p) {
+  gps_ubx_t     frame;
+  gps_NAV_PVT_t pvt;
+
+  frame.msg_class = p->ubx[0];
+  frame.msg_id    = p->ubx[1];
+  frame.length    = p->ubx_length;
+  frame.payload   = p->ubx+4;
+  p->stats.accepted[GPS_SENTENCE_UBX]++;
+
+  if(p->ubx_callback)
+    p->ubx_callback(p->user, &frame);
+  if(p->NAV_PVT_callback == NULL && !AGGREGATING(p) && !TRACKING_FIX(p)) return;
+  if(!gps_ubx_NAV_PVT(&frame, &pvt)) return;
+  fix_state(p, pvt.flags & GPS_PVT_GNSS_FIX_OK);
+  if((pvt.valid & GPS_PVT_VALID_DATE) && (pvt.valid & GPS_PVT_VALID_TIME)
+     && pvt.month >= 1 && pvt.month <= 12 && pvt.day >= 1 && pvt.day <= 31
+     && pvt.hour < 24 && pvt.min < 60 && pvt.sec <= 60)
+    utc_date(p, gps_utc_days(pvt.year, pvt.month, pvt.day),
+             pvt.hour*3600000u + pvt.min*60000u + pvt.sec*1000u);
+  if(p->NAV_PVT_callback)
+    p->NAV_PVT_callback(p->user, &pvt);
+  if(AGGREGATING(p))
+    fix_add_PVT(p, &pvt);
+}
+#endif
+
+/****************************************************************************/
+static int set_handler(gps_parser_t *p, const char *header, gps_sentence_handler_func handler,
+                       enum gps_sentence_type type) {
+  uint64_t key = header_key(header, strlen(header));
+  struct gps_handler *h;
+
+  if(key == 0) return 0;
+  h = handler_slot(p, key);
+  if(h->key == 0) {
+    if(p->handlers_used == GPS_MAX_HANDLERS) return 0;
+    p->handlers_used++;
+    h->key = key;
   }
+  h->handler = handler;
+  h->type    = type;
+  return 1;
+}
+
+/****************************************************************************/
+int gps_parser_handler_set(gps_parser_t *p, const char *header, gps_sentence_handler_func handler) {
+  return set_handler(p, header, handler, GPS_SENTENCE_OTHER);
+}
+
+/****************************************************************************/
+static int is_hex_char(int c) {
+  return gps_char_class[c] & GPS_CHAR_HEX;
+}
+/****************************************************************************/
+static int is_NMEA_char(gps_parser_t *p, int c) {
+  return GPS_IS_NMEA_CHAR(c, p->charset);
+}
+/****************************************************************************/
+void gps_parser_init(gps_parser_t *p, void *user) {
+  memset(p, 0, sizeof(*p));
+  p->user        = user;
+  p->scan        = gps_scan_select();
+  p->charset     = GPS_CHARSET_STRICT;
+  p->buffer      = p->own_buffer;
+  p->buffer_size = GPS_BUFFER_SIZE;
+  p->earliest_utc = GPS_EARLIEST_UTC;
+#if GPS_ENABLE_GGA
+  set_handler(p, "GGA", parse_GPGGA, GPS_SENTENCE_GGA);
+#endif
+#if GPS_ENABLE_GLL
+  set_handler(p, "GLL", parse_GPGLL, GPS_SENTENCE_GLL);
+#endif
+#if GPS_ENABLE_GSA
+  set_handler(p, "GSA", parse_GPGSA, GPS_SENTENCE_GSA);
+#endif
+#if GPS_ENABLE_RMC
+  set_handler(p, "RMC", parse_GPRMC, GPS_SENTENCE_RMC);
+#endif
+#if GPS_ENABLE_GSV
+  set_handler(p, "GSV", parse_GPGSV, GPS_SENTENCE_GSV);
+#endif
+#if GPS_ENABLE_VTG
+  set_handler(p, "VTG", parse_GPVTG, GPS_SENTENCE_VTG);
+#endif
+  gps_parser_reset(p);
+}
+
+/****************************************************************************/
+void gps_parser_reset(gps_parser_t *p) {
+  p->state       = gps_state_wait_for_nl;
+  p->checksum    = 0;
+  p->synced      = 0;
+  p->buffer_used = 0;
+  p->stop        = 0;
+  p->sky_next    = 0;
+  p->utc_known   = 0;
+  p->fix_state   = gps_fix_state_unknown;
+  memset(&p->fix, 0, sizeof(p->fix));
+}
 
-  if(sentence_type("GPVTG")) {
-     if(!parse_GPVTG())
-       reject("Parse error",buffer);
-     return;
+/****************************************************************************/
+int gps_parser_buffer_set(gps_parser_t *p, char *buffer, size_t size) {
+  if(buffer == NULL) {
+    buffer = p->own_buffer;
+    size   = GPS_BUFFER_SIZE;
   }
-  reject("Unknown sentence", buffer);
+  if(size < GPS_MIN_BUFFER_SIZE || size > GPS_MAX_BUFFER_SIZE) return 0;
+  p->buffer      = buffer;
+  p->buffer_size = size;
+  p->buffer_used = 0;
+  if(p->state == gps_state_should_be_NMEA || p->state == gps_state_checksum1
+     || p->state == gps_state_checksum2 || p->state == gps_state_should_be_nl)
+    p->state = gps_state_wait_for_nl;
+  return 1;
 }
+
 /****************************************************************************/
-static int is_hex_char(char c) {
-  if( c >= '0' && c <= '9') return 1;
-  if( c >= 'A' && c <= 'F') return 1;
-  return 0;
+void gps_parser_charset_set(gps_parser_t *p, unsigned charset) {
+  p->charset = charset;
 }
+
 /****************************************************************************/
-static int is_NMEA_char(char c) {
-  if( c >= '0' && c <= '9') return 1;
-  if( c >= 'A' && c <= 'Z') return 1;
-  if( c == ',')             return 1;
-  if( c == '.')             return 1;
-  return 0;
+static void start_sentence(gps_parser_t *p) {
+  p->state = gps_state_should_be_NMEA;
+  p->checksum = 0;
+  p->buffer_used = 0;
+  p->sentence.fields   = 1;
+  p->sentence.start[0] = 0;
 }
+
 /****************************************************************************/
-void gps_add_char(int c) {
-  switch(state) {
-    case state_wait_for_nl:
-      if(c != '\n') break;
-      state = state_should_be_dollar;
+static void add_char(gps_parser_t *p, int c) {
+  switch(p->state) {
+    case gps_state_wait_for_nl:
+#if GPS_ENABLE_UBX
+      if(c == UBX_SYNC1) {
+        p->state = gps_state_ubx_sync2;
+        return;
+      }
+#endif
+      if(c != '\n') return;
+      p->state = gps_state_should_be_dollar;
       return;
 
-    case state_should_be_dollar:
+    case gps_state_should_be_dollar:
+#if GPS_ENABLE_UBX
+      if(c == UBX_SYNC1) {
+        p->state = gps_state_ubx_sync2;
+        return;
+      }
+#endif
+      /* Blank lines don't lose the sentence after them */
+      if(c == '\n') return;
       if(c != '$') break;
-
-      state = state_should_be_NMEA;
-      checksum = 0;
-      buffer_used = 0;
+      start_sentence(p);
       return;
 
-    case state_should_be_NMEA:
+    case gps_state_should_be_NMEA:
       if(c == '*') {
-	buffer[buffer_used++] = 0;
-	state = state_checksum1;
+	p->buffer[p->buffer_used++] = 0;
+	if(p->buffer_used > p->stats.max_sentence_length)
+	  p->stats.max_sentence_length = p->buffer_used;
+	p->sentence.start[p->sentence.fields] = p->buffer_used;
+	p->state = gps_state_checksum1;
         return;
       }
 
-      if(!is_NMEA_char(c)) break;
+      if(!is_NMEA_char(p, c)) break;
       /* Add to buffer */
-      if(buffer_used == BUFFER_SIZE-1) {
-        reject("NMEA sentence too long",NULL);
+      if(p->buffer_used == p->buffer_size-1) {
+        reject(p, GPS_REJECT_TOO_LONG, NULL);
         break;
       }
 
-      buffer[buffer_used++] = c;	
-      checksum ^= c;
+      /* Note where the next field starts */
+      if(c == ',') {
+        if(p->sentence.fields == GPS_MAX_FIELDS) {
+          reject(p, GPS_REJECT_TOO_MANY_FIELDS, NULL);
+          break;
+        }
+        p->sentence.start[p->sentence.fields++] = p->buffer_used+1;
+      }
+
+      p->buffer[p->buffer_used++] = c;	
+      p->checksum ^= c;
       return;
 
-    case state_checksum1:
+    case gps_state_checksum1:
       if(!is_hex_char(c)) break;
       /* Remove from checksum */
-      if(c >= '0' && c <= '9') checksum ^= (c-'0')<<4;
-      if(c >= 'A' && c <= 'F') checksum ^= (c-'A'+10)<<4;
-      state = state_checksum2;
+      if(c >= '0' && c <= '9') p->checksum ^= (c-'0')<<4;
+      if(c >= 'A' && c <= 'F') p->checksum ^= (c-'A'+10)<<4;
+      p->state = gps_state_checksum2;
       return;
 
-    case state_checksum2:
+    case gps_state_checksum2:
       if(!is_hex_char(c)) break; 
       /* Remove from checksum */
-      if(c >= '0' && c <= '9') checksum ^= (c-'0');
-      if(c >= 'A' && c <= 'F') checksum ^= (c-'A'+10);
-      state = state_should_be_nl;
+      if(c >= '0' && c <= '9') p->checksum ^= (c-'0');
+      if(c >= 'A' && c <= 'F') p->checksum ^= (c-'A'+10);
+      p->state = gps_state_should_be_nl;
       return;
 
-    case state_should_be_nl:
+    case gps_state_should_be_nl:
       if(c == '\r') return;
       if(c != '\n') break;
 
-      if(checksum != 0) {
-	 reject("Invalid checksum",buffer);
+      if(p->checksum != 0) {
+	 reject(p, GPS_REJECT_CHECKSUM, p->buffer);
 	 return;
       }
-      parse_data();
-      synced = 1;
-      state  = state_should_be_dollar;
+      if(p->timing)
+        parse_data_timed(p);
+      else
+        parse_data(p);
+      p->synced = 1;
+      p->state  = gps_state_should_be_dollar;
+      return;
+
+#if GPS_ENABLE_UBX
+    case gps_state_ubx_sync2:
+      /* A lone 0xB5 at the end of a line of noise mustn't take the newline
+         with it, and a doubled one may still be followed by a frame */
+      if(c == '\n') {
+        p->state = gps_state_should_be_dollar;
+        return;
+      }
+      if(c == UBX_SYNC1) return;
+      if(c != UBX_SYNC2) break;
+      p->ubx_used = 0;
+      p->ubx_ck_a = 0;
+      p->ubx_ck_b = 0;
+      p->state    = gps_state_ubx_header;
+      return;
+
+    case gps_state_ubx_header:
+      ubx_add(p, c);
+      if(p->ubx_used < 4) return;
+      p->ubx_length = p->ubx[2] | p->ubx[3]<<8;
+      if(p->ubx_length > GPS_UBX_BUFFER_SIZE) {
+        /* Nothing that long is ever decoded, so this is far more likely to
+           be 0xB5 0x62 in line noise than a frame. Rather than swallow up
+           to 64K of NMEA waiting for its checksum, go back over the header
+           as NMEA, which picks up a '\n' or '$' in it */
+        unsigned char header[4];
+        unsigned      i;
+
+        memcpy(header, p->ubx, sizeof(header));
+        reject(p, GPS_REJECT_TOO_LONG, NULL);
+        p->state = gps_state_wait_for_nl;
+        for(i = 0; i < sizeof(header); i++)
+          add_char(p, header[i]);
+        return;
+      }
+      p->state      = p->ubx_length ? gps_state_ubx_payload : gps_state_ubx_ck_a;
+      return;
+
+    case gps_state_ubx_payload:
+      ubx_add(p, c);
+      if(p->ubx_used == 4 + p->ubx_length)
+        p->state = gps_state_ubx_ck_a;
+      return;
+
+    case gps_state_ubx_ck_a:
+      if(c != p->ubx_ck_a) {
+        reject(p, GPS_REJECT_CHECKSUM, NULL);
+        p->state = gps_state_should_be_dollar;
+        return;
+      }
+      p->state = gps_state_ubx_ck_b;
+      return;
+
+    case gps_state_ubx_ck_b:
+      /* Whatever the outcome, NMEA (or another frame) can follow directly */
+      p->state = gps_state_should_be_dollar;
+      if(c != p->ubx_ck_b) {
+        reject(p, GPS_REJECT_CHECKSUM, NULL);
+        return;
+      }
+      parse_ubx(p);
+      p->synced = 1;
       return;
+#else
+    default:
+      break;
+#endif
+  }
+  if(p->synced)
+    p->stats.resyncs++;
+  p->synced = 0;
+  /* A '$' out of place starts a new sentence, and a newline ends the line
+     a bad one was on, so the sentence after a bad character or a cut off
+     sentence isn't lost as well */
+  if(c == '$') {
+    start_sentence(p);
+    return;
+  }
+  p->state = c == '\n' ? gps_state_should_be_dollar : gps_state_wait_for_nl;
+}
+
+/****************************************************************************/
+void gps_parser_add_char(gps_parser_t *p, int c) {
+  /* There is no early return here, so a stop asked for by this character
+     must not carry over to the next call */
+  p->stop = 0;
+  p->stats.bytes++;
+  add_char(p, c & 0xFF);
+}
+
+/****************************************************************************/
+size_t gps_parser_add_bytes(gps_parser_t *p, const char *data, size_t len) {
+  const char *start = data;
+  const char *end   = data + len;
+
+  /* Only a stop asked for during this call counts */
+  p->stop = 0;
+  while(data != end) {
+    switch(p->state) {
+      case gps_state_wait_for_nl:
+        /* Nothing but a newline (or the start of a UBX frame) can get us
+           out of here */
+        {
+          const char *next = memchr(data, '\n', end-data);
+#if GPS_ENABLE_UBX
+          const char *ubx  = memchr(data, UBX_SYNC1, (next ? next : end) - data);
+          if(ubx != NULL) next = ubx;
+#endif
+          if(next == NULL) {
+            data = end;
+            continue;
+          }
+          data = next;
+        }
+        break;
+
+#if GPS_ENABLE_UBX
+      case gps_state_ubx_payload:
+        /* All but the last byte of the payload, which add_char() takes */
+        {
+          size_t run = 4 + p->ubx_length - p->ubx_used - 1;
+          if(run > (size_t)(end-data))
+            run = end-data;
+          while(run--)
+            ubx_add(p, (unsigned char)*data++);
+        }
+        if(data == end) continue;
+        break;
+#endif
+
+      case gps_state_should_be_NMEA:
+        /* Copy the run of sentence characters in one go, noting where each
+           field starts. The character that stops the run ('*', a bad
+           character, or one too many) is left for add_char() */
+        {
+          unsigned short commas[GPS_MAX_FIELDS];
+          unsigned       ncommas, i;
+          size_t         run = p->buffer_size-1 - p->buffer_used;
+
+          if(run > (size_t)(end-data))
+            run = end-data;
+          run = p->scan(data, run, &p->checksum, commas, &ncommas,
+                        GPS_MAX_FIELDS - p->sentence.fields, p->charset);
+
+          memcpy(p->buffer + p->buffer_used, data, run);
+          for(i = 0; i < ncommas; i++)
+            p->sentence.start[p->sentence.fields++] = p->buffer_used + commas[i] + 1;
+          p->buffer_used += run;
+          data           += run;
+        }
+        if(data == end) continue;
+        break;
+
+      default:
+        break;
+    }
+    add_char(p, (unsigned char)*data++);
+
+    /* A callback has asked for control back */
+    if(p->stop) {
+      p->stop = 0;
+      p->stats.bytes += data - start;
+      return data - start;
+    }
+  }
+  p->stats.bytes += len;
+  return len;
+}
+
+/****************************************************************************/
+size_t gps_parser_add_bytes_at(gps_parser_t *p, const char *data, size_t len, int64_t rx_ns) {
+  p->rx_ns = rx_ns;
+  return gps_parser_add_bytes(p, data, len);
+}
+
+/****************************************************************************/
+void gps_parser_earliest_utc_set(gps_parser_t *p, int64_t seconds) {
+  p->earliest_utc = seconds;
+}
+
+/****************************************************************************/
+void gps_parser_stats(const gps_parser_t *p, gps_stats_t *stats) {
+  *stats = p->stats;
+}
+
+/****************************************************************************/
+void gps_parser_stats_reset(gps_parser_t *p) {
+  memset(&p->stats, 0, sizeof(p->stats));
+}
+
+/****************************************************************************/
+void gps_parser_timing_set(gps_parser_t *p, int enable) {
+  p->timing = enable;
+}
+
+/****************************************************************************/
+void gps_parser_stop(gps_parser_t *p) {
+  p->stop = 1;
+}
+
+/****************************************************************************/
+gps_parser_GPGGA_callback_func gps_parser_GPGGA_callback_set(gps_parser_t *p, gps_parser_GPGGA_callback_func cb) {
+  gps_parser_GPGGA_callback_func rtn = p->GPGGA_callback;
+  p->GPGGA_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_parser_GPRMC_callback_func gps_parser_GPRMC_callback_set(gps_parser_t *p, gps_parser_GPRMC_callback_func cb) {
+  gps_parser_GPRMC_callback_func rtn = p->GPRMC_callback;
+  p->GPRMC_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_parser_GPVTG_callback_func gps_parser_GPVTG_callback_set(gps_parser_t *p, gps_parser_GPVTG_callback_func cb) {
+  gps_parser_GPVTG_callback_func rtn = p->GPVTG_callback;
+  p->GPVTG_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_parser_GPGLL_callback_func gps_parser_GPGLL_callback_set(gps_parser_t *p, gps_parser_GPGLL_callback_func cb) {
+  gps_parser_GPGLL_callback_func rtn = p->GPGLL_callback;
+  p->GPGLL_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_GGA_callback_func gps_parser_GGA_callback_set(gps_parser_t *p, gps_GGA_callback_func cb) {
+  gps_GGA_callback_func rtn = p->GGA_callback;
+  p->GGA_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_RMC_callback_func gps_parser_RMC_callback_set(gps_parser_t *p, gps_RMC_callback_func cb) {
+  gps_RMC_callback_func rtn = p->RMC_callback;
+  p->RMC_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_GLL_callback_func gps_parser_GLL_callback_set(gps_parser_t *p, gps_GLL_callback_func cb) {
+  gps_GLL_callback_func rtn = p->GLL_callback;
+  p->GLL_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_VTG_callback_func gps_parser_VTG_callback_set(gps_parser_t *p, gps_VTG_callback_func cb) {
+  gps_VTG_callback_func rtn = p->VTG_callback;
+  p->VTG_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_GSA_callback_func gps_parser_GSA_callback_set(gps_parser_t *p, gps_GSA_callback_func cb) {
+  gps_GSA_callback_func rtn = p->GSA_callback;
+  p->GSA_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_GSV_callback_func gps_parser_GSV_callback_set(gps_parser_t *p, gps_GSV_callback_func cb) {
+  gps_GSV_callback_func rtn = p->GSV_callback;
+  p->GSV_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_view_callback_func gps_parser_view_callback_set(gps_parser_t *p, enum gps_sentence_type type,
+                                                    gps_view_callback_func cb) {
+  gps_view_callback_func rtn;
+  if(type >= GPS_SENTENCE_OTHER) return NULL;
+  rtn = p->view_callback[type];
+  p->view_callback[type] = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_ubx_callback_func gps_parser_ubx_callback_set(gps_parser_t *p, gps_ubx_callback_func cb) {
+  gps_ubx_callback_func rtn = p->ubx_callback;
+  p->ubx_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_NAV_PVT_callback_func gps_parser_NAV_PVT_callback_set(gps_parser_t *p, gps_NAV_PVT_callback_func cb) {
+  gps_NAV_PVT_callback_func rtn = p->NAV_PVT_callback;
+  p->NAV_PVT_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_fix_callback_func gps_parser_fix_callback_set(gps_parser_t *p, gps_fix_callback_func cb) {
+  gps_fix_callback_func rtn = p->fix_callback;
+  p->fix_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_parser_reject_callback_func gps_parser_reject_callback_set(gps_parser_t *p, gps_parser_reject_callback_func cb) {
+  gps_parser_reject_callback_func rtn = p->reject_callback;
+  p->reject_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_parser_no_fix_callback_func gps_parser_no_fix_callback_set(gps_parser_t *p, gps_parser_no_fix_callback_func cb) {
+  gps_parser_no_fix_callback_func rtn = p->no_fix_callback;
+  p->no_fix_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+gps_parser_fix_acquired_callback_func gps_parser_fix_acquired_callback_set(gps_parser_t *p,
+                                                                    gps_parser_fix_acquired_callback_func cb) {
+  gps_parser_fix_acquired_callback_func rtn = p->fix_acquired_callback;
+  p->fix_acquired_callback = cb;
+  return rtn;
+}
+
+/****************************************************************************/
+/* The original single-receiver API, working on a shared default instance   */
+/****************************************************************************/
+static gps_parser_t *default_instance(void) {
+  if(!default_parser_ready) {
+    gps_parser_init(&default_parser, NULL);
+    default_parser_ready = 1;
   }
-  state  = state_wait_for_nl;
-  synced = 0;
+  return &default_parser;
+}
+
+/****************************************************************************/
+void gps_add_char(int c) {
+  gps_parser_add_char(default_instance(), c);
+}
+
+/****************************************************************************/
+size_t gps_add_bytes(const char *data, size_t len) {
+  return gps_parser_add_bytes(default_instance(), data, len);
+}
+
+/****************************************************************************/
+/* The default instance calls these through the wrappers below, which drop  */
+/* the user pointer                                                         */
+/****************************************************************************/
+static gps_GPGGA_callback_func        legacy_GPGGA;
+static gps_GPRMC_callback_func        legacy_GPRMC;
+static gps_GPVTG_callback_func        legacy_GPVTG;
+static gps_GPGLL_callback_func        legacy_GPGLL;
+static gps_reject_callback_func       legacy_reject;
+static gps_no_fix_callback_func       legacy_no_fix;
+static gps_fix_acquired_callback_func legacy_fix_acquired;
+
+static void call_GPGGA(void *user, unsigned fix_quality, unsigned no_of_sats, double timestamp,
+                       double latitude, char latitude_ns, double longitude, char longitude_ew,
+                       double altitude, char alt_units, double hor_dop) {
+  legacy_GPGGA(fix_quality, no_of_sats, timestamp, latitude, latitude_ns, longitude, longitude_ew,
+               altitude, alt_units, hor_dop);
+}
+
+static void call_GPRMC(void *user, double timestamp, double date_of_fix, char nav_warning,
+                       double latitude, char latitude_ns, double longitude, char longitude_ew,
+                       double speed_knots, double course) {
+  legacy_GPRMC(timestamp, date_of_fix, nav_warning, latitude, latitude_ns, longitude, longitude_ew,
+               speed_knots, course);
+}
+
+static void call_GPVTG(void *user, double value, char unit) {
+  legacy_GPVTG(value, unit);
+}
+
+static void call_GPGLL(void *user, double timestamp, double latitude, char latitude_ns,
+                       double longitude, char longitude_ew) {
+  legacy_GPGLL(timestamp, latitude, latitude_ns, longitude, longitude_ew);
+}
+
+static void call_reject(void *user, char *message, char *buffer) {
+  legacy_reject(message, buffer);
+}
+
+static void call_no_fix(void *user) {
+  legacy_no_fix();
+}
+
+static void call_fix_acquired(void *user) {
+  legacy_fix_acquired();
+}
+
+/****************************************************************************/
+gps_GPGGA_callback_func gps_GPGGA_callback_set(gps_GPGGA_callback_func cb) {
+  gps_GPGGA_callback_func rtn = legacy_GPGGA;
+  legacy_GPGGA = cb;
+  gps_parser_GPGGA_callback_set(default_instance(), cb ? call_GPGGA : NULL);
+  return rtn;
 }
 
 /****************************************************************************/
-gps_GPGGA_callback_func  gps_GPGGA_callback_set(gps_GPGGA_callback_func cb) {
-  gps_GPGGA_callback_func rtn = GPGGA_callback;
-  GPGGA_callback = cb;
+gps_GPRMC_callback_func gps_GPRMC_callback_set(gps_GPRMC_callback_func cb) {
+  gps_GPRMC_callback_func rtn = legacy_GPRMC;
+  legacy_GPRMC = cb;
+  gps_parser_GPRMC_callback_set(default_instance(), cb ? call_GPRMC : NULL);
   return rtn;
 }
 
 /****************************************************************************/
-gps_GPRMC_callback_func  gps_GPRMC_callback_set(gps_GPRMC_callback_func cb) {
-  gps_GPRMC_callback_func rtn = GPRMC_callback;
-  GPRMC_callback = cb;
+gps_GPVTG_callback_func gps_GPVTG_callback_set(gps_GPVTG_callback_func cb) {
+  gps_GPVTG_callback_func rtn = legacy_GPVTG;
+  legacy_GPVTG = cb;
+  gps_parser_GPVTG_callback_set(default_instance(), cb ? call_GPVTG : NULL);
   return rtn;
 }
 
 /****************************************************************************/
-gps_GPVTG_callback_func  gps_GPVTG_callback_set(gps_GPVTG_callback_func cb) {
-  gps_GPVTG_callback_func rtn = GPVTG_callback;
-  GPVTG_callback = cb;
+gps_GPGLL_callback_func gps_GPGLL_callback_set(gps_GPGLL_callback_func cb) {
+  gps_GPGLL_callback_func rtn = legacy_GPGLL;
+  legacy_GPGLL = cb;
+  gps_parser_GPGLL_callback_set(default_instance(), cb ? call_GPGLL : NULL);
   return rtn;
 }
 
 /****************************************************************************/
-gps_GPGLL_callback_func  gps_GPGLL_callback_set(gps_GPGLL_callback_func cb) {
-  gps_GPGLL_callback_func rtn = GPGLL_callback;
-  GPGLL_callback = cb;
+gps_reject_callback_func gps_reject_callback_set(gps_reject_callback_func cb) {
+  gps_reject_callback_func rtn = legacy_reject;
+  legacy_reject = cb;
+  gps_parser_reject_callback_set(default_instance(), cb ? call_reject : NULL);
   return rtn;
 }
 
 /****************************************************************************/
-gps_reject_callback_func gps_reject_callback_set(gps_reject_callback_func cb){
-  gps_reject_callback_func rtn = reject_callback;
-  reject_callback = cb;
+gps_no_fix_callback_func gps_no_fix_callback_set(gps_no_fix_callback_func cb) {
+  gps_no_fix_callback_func rtn = legacy_no_fix;
+  legacy_no_fix = cb;
+  gps_parser_no_fix_callback_set(default_instance(), cb ? call_no_fix : NULL);
   return rtn;
 }
 
 /****************************************************************************/
-gps_no_fix_callback_func gps_no_fix_callback_set(gps_no_fix_callback_func cb){
-  gps_no_fix_callback_func rtn = no_fix_callback;
-  no_fix_callback = cb;
+gps_fix_acquired_callback_func gps_fix_acquired_callback_set(gps_fix_acquired_callback_func cb) {
+  gps_fix_acquired_callback_func rtn = legacy_fix_acquired;
+  legacy_fix_acquired = cb;
+  gps_parser_fix_acquired_callback_set(default_instance(), cb ? call_fix_acquired : NULL);
   return rtn;
 }
 
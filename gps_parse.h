@@ -30,10 +30,546 @@
 
 #ifndef GPS_PARSE_H
 #define GPS_PARSE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "gps_scan.h"
+
+/****************************************************************************
+* Build configuration. Define any of these to 0 (say -DGPS_ENABLE_GSV=0) to
+* leave that sentence's decoder out altogether. Its callbacks can still be
+* set but are never called, and the sentence is rejected as unknown.
+****************************************************************************/
+#ifndef GPS_ENABLE_GGA
+#define GPS_ENABLE_GGA 1
+#endif
+#ifndef GPS_ENABLE_RMC
+#define GPS_ENABLE_RMC 1
+#endif
+#ifndef GPS_ENABLE_GLL
+#define GPS_ENABLE_GLL 1
+#endif
+#ifndef GPS_ENABLE_VTG
+#define GPS_ENABLE_VTG 1
+#endif
+#ifndef GPS_ENABLE_GSA
+#define GPS_ENABLE_GSA 1
+#endif
+#ifndef GPS_ENABLE_GSV
+#define GPS_ENABLE_GSV 1
+#endif
+#ifndef GPS_ENABLE_UBX
+#define GPS_ENABLE_UBX 1          /* u-blox binary frames mixed in with NMEA */
+#endif
+
+/* Every callback is handed the user pointer given to gps_parser_init() */
+typedef void (*gps_parser_reject_callback_func)(void *user, char *message, char *buffer);
+typedef void (*gps_parser_no_fix_callback_func)(void *user);
+typedef void (*gps_parser_fix_acquired_callback_func)(void *user);
+typedef void (*gps_parser_GPGGA_callback_func)(void *user, unsigned fix_quality, unsigned no_of_sats, double   timestamp,
+       double   latitude, char     latitude_ns, double   longitude, char     longitude_ew,
+       double   altitude, char     alt_units,   double   hor_dop);
+typedef void (*gps_parser_GPRMC_callback_func)(void *user, double timestamp,   double   date_of_fix, char   nav_warning,
+    double   latitude,    char   latitude_ns, double   longitude,   char   longitude_ew, 
+    double   speed_knots, double course);
+typedef void (*gps_parser_GPVTG_callback_func)(void *user, double value, char unit);
+typedef void (*gps_parser_GPGLL_callback_func)(void *user, double   timestamp, double   latitude,  char     latitude_ns,
+	                  double   longitude, char     longitude_ew);
+
+/****************************************************************************
+* Decoded sentences, for the struct based callbacks. Positions come both as
+* doubles in degrees and as integer nanodegrees, which are exact and so
+* reproduce bit for bit. South and west are negative. talker is the two
+* letter talker ID ("GP", "GN"...).
+*
+* utc_ns is the time as nanoseconds since 1970 UTC, from the time of day and
+* the date of the last RMC (or NAV-PVT), moving on a day when the time
+* passes midnight. It is 0 until a date has been received. rx_ns is the host
+* receive time given with the bytes to gps_parser_add_bytes_at(), or 0.
+****************************************************************************/
+typedef struct gps_GGA {
+  char      talker[3];
+  unsigned  time_ms;          /* UTC time of day in milliseconds */
+  double    timestamp;        /* hhmmss.ss, as sent */
+  int64_t   utc_ns;
+  int64_t   rx_ns;
+  double    latitude;
+  double    longitude;
+  int64_t   latitude_ndeg;
+  int64_t   longitude_ndeg;
+  unsigned  fix_quality;
+  unsigned  no_of_sats;
+  double    hor_dop;
+  double    altitude;         /* metres above mean sea level */
+  int32_t   altitude_mm;
+} gps_GGA_t;
+
+typedef struct gps_RMC {
+  char      talker[3];
+  char      nav_warning;
+  unsigned  time_ms;
+  double    timestamp;
+  int64_t   utc_ns;
+  int64_t   rx_ns;
+  unsigned  date;             /* ddmmyy */
+  double    latitude;
+  double    longitude;
+  int64_t   latitude_ndeg;
+  int64_t   longitude_ndeg;
+  double    speed_knots;
+  double    course;
+} gps_RMC_t;
+
+typedef struct gps_GLL {
+  char      talker[3];
+  unsigned  time_ms;
+  double    timestamp;
+  int64_t   utc_ns;
+  int64_t   rx_ns;
+  double    latitude;
+  double    longitude;
+  int64_t   latitude_ndeg;
+  int64_t   longitude_ndeg;
+} gps_GLL_t;
+
+#define GPS_VTG_COURSE_TRUE     1
+#define GPS_VTG_COURSE_MAGNETIC 2
+#define GPS_VTG_SPEED_KNOTS     4
+#define GPS_VTG_SPEED_KMH       8
+
+typedef struct gps_VTG {
+  char      talker[3];
+  unsigned  valid;            /* GPS_VTG_* bits for the values that were sent */
+  double    course_true;
+  double    course_magnetic;
+  double    speed_knots;
+  double    speed_kmh;
+} gps_VTG_t;
+
+typedef struct gps_GSA {
+  char      talker[3];
+  char      mode;             /* A = automatic, M = manual */
+  unsigned  fix_type;         /* 1 = none, 2 = 2D, 3 = 3D */
+  unsigned  no_of_prns;
+  unsigned  prn[12];          /* satellites used in the fix */
+  double    pos_dop;
+  double    hor_dop;
+  double    vert_dop;
+} gps_GSA_t;
+
+/* Satellites in view, collected from a whole GSV sequence. Values that were
+   not sent (e.g. the SNR of a satellite not being tracked) are -1 */
+#define GPS_MAX_SATS 36
+
+typedef struct gps_sat {
+  unsigned short prn;
+  short          elevation;   /* degrees */
+  short          azimuth;     /* degrees from true north */
+  short          snr;         /* dB-Hz */
+} gps_sat_t;
+
+typedef struct gps_sky {
+  char      talker[3];
+  unsigned  sats_in_view;     /* as reported, may be more than count */
+  unsigned  count;
+  gps_sat_t sat[GPS_MAX_SATS];
+} gps_sky_t;
+
+/* One fix, merged from all the sentences sent for the same time (epoch).
+   have says which groups of values were received */
+#define GPS_FIX_TIME     0x01
+#define GPS_FIX_POSITION 0x02
+#define GPS_FIX_ALTITUDE 0x04   /* altitude */
+#define GPS_FIX_QUALITY  0x08   /* fix_quality, no_of_sats, hor_dop */
+#define GPS_FIX_VELOCITY 0x10   /* speed_knots, course */
+#define GPS_FIX_DATE     0x20
+#define GPS_FIX_DOP      0x40   /* fix_type and all three DOPs */
+#define GPS_FIX_UTC      0x80   /* utc_ns */
+
+/* rx_ns is that of the first sentence of the epoch */
+typedef struct gps_fix {
+  unsigned  have;
+  unsigned  time_ms;
+  int64_t   utc_ns;
+  int64_t   rx_ns;
+  int64_t   latitude_ndeg;
+  int64_t   longitude_ndeg;
+  double    latitude;
+  double    longitude;
+  double    altitude;
+  double    speed_knots;
+  double    course;
+  double    hor_dop;
+  double    pos_dop;
+  double    vert_dop;
+  unsigned  date;             /* ddmmyy */
+  unsigned  fix_quality;
+  unsigned  no_of_sats;
+  unsigned  fix_type;
+  char      talker[3];
+} gps_fix_t;
+
+/* A UBX frame that passed its checksum. A header giving a length over
+   GPS_UBX_BUFFER_SIZE is taken to be noise, and the bytes after it are
+   read as NMEA again */
+typedef struct gps_ubx {
+  unsigned char        msg_class;
+  unsigned char        msg_id;
+  unsigned short       length;
+  const unsigned char *payload;
+} gps_ubx_t;
+
+#define GPS_UBX_NAV     0x01
+#define GPS_UBX_NAV_PVT 0x07
+
+/* UBX-NAV-PVT, in the receiver's own units */
+#define GPS_PVT_VALID_DATE  0x01
+#define GPS_PVT_VALID_TIME  0x02
+#define GPS_PVT_GNSS_FIX_OK 0x01
+#define GPS_PVT_DIFF_SOLN   0x02
+
+typedef struct gps_NAV_PVT {
+  uint32_t  itow;             /* GPS time of week, ms */
+  uint16_t  year;
+  uint8_t   month, day, hour, min, sec;
+  uint8_t   valid;            /* GPS_PVT_VALID_* */
+  uint32_t  time_acc;         /* ns */
+  int32_t   nano;             /* -1e9..1e9, added to sec */
+  uint8_t   fix_type;         /* 0 none, 2 = 2D, 3 = 3D, 4 = GNSS + dead reckoning */
+  uint8_t   flags;            /* GPS_PVT_GNSS_FIX_OK etc */
+  uint8_t   num_sv;
+  int32_t   longitude;        /* 1e-7 degrees */
+  int32_t   latitude;
+  int32_t   height;           /* above ellipsoid, mm */
+  int32_t   height_msl;       /* mm */
+  uint32_t  hor_acc;          /* mm */
+  uint32_t  vert_acc;
+  int32_t   vel_n, vel_e, vel_d;   /* mm/s */
+  int32_t   ground_speed;     /* mm/s */
+  int32_t   heading;          /* heading of motion, 1e-5 degrees */
+  uint32_t  speed_acc;
+  uint32_t  heading_acc;
+  uint16_t  pos_dop;          /* 0.01 */
+} gps_NAV_PVT_t;
+
+typedef void (*gps_GGA_callback_func)(void *user, const gps_GGA_t *gga);
+typedef void (*gps_RMC_callback_func)(void *user, const gps_RMC_t *rmc);
+typedef void (*gps_GLL_callback_func)(void *user, const gps_GLL_t *gll);
+typedef void (*gps_VTG_callback_func)(void *user, const gps_VTG_t *vtg);
+typedef void (*gps_GSA_callback_func)(void *user, const gps_GSA_t *gsa);
+typedef void (*gps_GSV_callback_func)(void *user, const gps_sky_t *sky);
+typedef void (*gps_fix_callback_func)(void *user, const gps_fix_t *fix);
+typedef void (*gps_ubx_callback_func)(void *user, const gps_ubx_t *frame);
+typedef void (*gps_NAV_PVT_callback_func)(void *user, const gps_NAV_PVT_t *pvt);
+
+/****************************************************************************
+* Parser context - one per receiver. Nothing is shared between instances,
+* so each feed can be decoded on its own thread without any locking.
+****************************************************************************/
+#ifndef GPS_BUFFER_SIZE
+#define GPS_BUFFER_SIZE 128       /* built in buffer, see gps_parser_buffer_set() */
+#endif
+#define GPS_MIN_BUFFER_SIZE 16
+#define GPS_MAX_BUFFER_SIZE 65535 /* field offsets are 16 bit */
+#define GPS_MAX_FIELDS  40
+
+/* A validated sentence, split into fields as it was received. Field n
+   starts at text[start[n]] and runs up to the character before
+   text[start[n+1]], so no field ever needs to be searched for */
+typedef struct gps_sentence {
+  const char     *text;
+  unsigned        fields;
+  unsigned short  start[GPS_MAX_FIELDS+1];
+} gps_sentence_t;
+
+/* A sentence handler decodes one type of sentence, returning 0 if it could
+   not be parsed. Handlers are looked up in constant time by header */
+struct gps_parser;
+typedef int (*gps_sentence_handler_func)(struct gps_parser *p, const gps_sentence_t *s);
+
+#define GPS_HANDLER_SLOTS 32
+#define GPS_MAX_HANDLERS  24
+
+/* Sentence types that are counted separately in the statistics */
+enum gps_sentence_type {
+  GPS_SENTENCE_GGA,
+  GPS_SENTENCE_RMC,
+  GPS_SENTENCE_GLL,
+  GPS_SENTENCE_VTG,
+  GPS_SENTENCE_GSA,
+  GPS_SENTENCE_GSV,
+  GPS_SENTENCE_OTHER,         /* anything added with gps_parser_handler_set() */
+  GPS_SENTENCE_UBX,           /* UBX frames of any kind */
+  GPS_SENTENCE_TYPES
+};
+
+/* A view callback gets the checksummed sentence and its field table, with
+   nothing decoded yet. Read just the fields you need with gps_field_*() */
+typedef void (*gps_view_callback_func)(void *user, const gps_sentence_t *s);
+
+/* Field numbers, for reading views */
+enum {
+  GPS_GGA_TIME = 1, GPS_GGA_LATITUDE,  GPS_GGA_LATITUDE_NS, GPS_GGA_LONGITUDE, GPS_GGA_LONGITUDE_EW,
+  GPS_GGA_FIX_QUALITY, GPS_GGA_NO_OF_SATS, GPS_GGA_HOR_DOP, GPS_GGA_ALTITUDE, GPS_GGA_ALT_UNITS
+};
+enum {
+  GPS_RMC_TIME = 1, GPS_RMC_STATUS,    GPS_RMC_LATITUDE,    GPS_RMC_LATITUDE_NS, GPS_RMC_LONGITUDE,
+  GPS_RMC_LONGITUDE_EW, GPS_RMC_SPEED_KNOTS, GPS_RMC_COURSE, GPS_RMC_DATE, GPS_RMC_MAG_VARIATION,
+  GPS_RMC_MAG_VARIATION_EW, GPS_RMC_MODE
+};
+enum {
+  GPS_GLL_LATITUDE = 1, GPS_GLL_LATITUDE_NS, GPS_GLL_LONGITUDE, GPS_GLL_LONGITUDE_EW, GPS_GLL_TIME,
+  GPS_GLL_STATUS, GPS_GLL_MODE
+};
+
+struct gps_handler {
+  uint64_t                  key;
+  gps_sentence_handler_func handler;
+  enum gps_sentence_type    type;
+};
+
+/****************************************************************************
+* Statistics, kept by every parser at the cost of an increment or two.
+* The reject callback gets the matching message for each reason.
+****************************************************************************/
+enum gps_reject_reason {
+  GPS_REJECT_CHECKSUM,
+  GPS_REJECT_TOO_LONG,
+  GPS_REJECT_TOO_MANY_FIELDS,
+  GPS_REJECT_UNKNOWN,
+  GPS_REJECT_PARSE,
+  GPS_REJECT_REASONS
+};
+
+#define GPS_STATS_BUCKETS 32
+
+typedef struct gps_stats {
+  uint64_t bytes;
+  uint64_t accepted[GPS_SENTENCE_TYPES];
+  uint64_t rejected[GPS_REJECT_REASONS];
+  uint64_t skipped;           /* known sentences that nothing was set to receive */
+  uint64_t no_fix;            /* GGA, RMC and GLL that said there was no fix */
+  uint64_t resyncs;           /* times sync was lost after a good sentence */
+  unsigned max_sentence_length;
+  /* With timing on, parse_cycles[n] counts sentences that took 2^n to
+     2^(n+1)-1 TSC cycles to decode (nanoseconds where there is no TSC) */
+  uint64_t parse_cycles[GPS_STATS_BUCKETS];
+} gps_stats_t;
+
+enum gps_state {
+	gps_state_wait_for_nl,
+	gps_state_should_be_dollar,
+	gps_state_should_be_NMEA,
+	gps_state_checksum1,
+	gps_state_checksum2,
+	gps_state_should_be_nl,
+	gps_state_ubx_sync2,
+	gps_state_ubx_header,
+	gps_state_ubx_payload,
+	gps_state_ubx_ck_a,
+	gps_state_ubx_ck_b
+};
+
+#define GPS_UBX_BUFFER_SIZE 256  /* longest payload taken; NAV-PVT is 92 */
+
+/* Whether the receiver has a fix, from the last GGA, RMC, GLL or NAV-PVT */
+enum gps_fix_state {
+	gps_fix_state_unknown,
+	gps_fix_state_none,
+	gps_fix_state_fix
+};
+
+typedef struct gps_parser {
+  enum gps_state state;
+  char           checksum;
+  char           synced;
+  unsigned char  charset;
+  int            buffer_used;
+  int            buffer_size;
+  char          *buffer;      /* own_buffer, or one given to gps_parser_buffer_set() */
+  gps_sentence_t sentence;
+  gps_scan_func  scan;
+
+  /* UBX frame being received: class, id and length, then the payload */
+  unsigned       ubx_used;
+  unsigned       ubx_length;
+  unsigned char  ubx_ck_a, ubx_ck_b;
+  unsigned char  ubx[4+GPS_UBX_BUFFER_SIZE];
+
+  struct gps_handler handlers[GPS_HANDLER_SLOTS];
+  unsigned           handlers_used;
+
+  void                    *user;
+  gps_parser_GPGGA_callback_func  GPGGA_callback;
+  gps_parser_GPRMC_callback_func  GPRMC_callback;
+  gps_parser_GPVTG_callback_func  GPVTG_callback;
+  gps_parser_GPGLL_callback_func  GPGLL_callback;
+  gps_parser_reject_callback_func reject_callback;
+  gps_parser_no_fix_callback_func no_fix_callback;
+  gps_parser_fix_acquired_callback_func fix_acquired_callback;
+  gps_GGA_callback_func    GGA_callback;
+  gps_RMC_callback_func    RMC_callback;
+  gps_GLL_callback_func    GLL_callback;
+  gps_VTG_callback_func    VTG_callback;
+  gps_GSA_callback_func    GSA_callback;
+  gps_GSV_callback_func    GSV_callback;
+  gps_fix_callback_func    fix_callback;
+  gps_view_callback_func   view_callback[GPS_SENTENCE_TYPES];
+  gps_ubx_callback_func    ubx_callback;
+  gps_NAV_PVT_callback_func NAV_PVT_callback;
+
+  /* GSV sequence being collected */
+  gps_sky_t      sky;
+  unsigned       sky_total;
+  unsigned       sky_next;
+
+  /* Epoch being merged, when fix_callback or batch is set */
+  gps_fix_t      fix;
+  struct gps_batch *batch;
+  int            stop;
+
+  enum gps_fix_state fix_state;
+
+  /* UTC day from the last date, and the latest time of day seen in it */
+  int            utc_known;
+  int64_t        utc_day;
+  unsigned       utc_day_ms;
+  int64_t        earliest_utc;
+  int64_t        rx_ns;
+
+  gps_stats_t    stats;
+  int            timing;
+
+  char           own_buffer[GPS_BUFFER_SIZE];
+} gps_parser_t;
+
+/* The parser points into itself, so don't copy one once it is initialised */
+void gps_parser_init(gps_parser_t *p, void *user);
+void gps_parser_reset(gps_parser_t *p);
+/* Gives the parser a buffer of size bytes to collect sentences in, for
+   sentences of up to size-1 characters. NULL goes back to the built in
+   one. Any sentence part way through is dropped. Returns 0 if size is
+   not between GPS_MIN_BUFFER_SIZE and GPS_MAX_BUFFER_SIZE */
+int  gps_parser_buffer_set(gps_parser_t *p, char *buffer, size_t size);
+/* The characters allowed in a sentence, GPS_CHARSET_STRICT (the default)
+   or GPS_CHARSET_LENIENT. See gps_scan.h */
+void gps_parser_charset_set(gps_parser_t *p, unsigned charset);
+void gps_parser_add_char(gps_parser_t *p, int c);
+/* Same as calling gps_parser_add_char() for each byte, only faster. Returns
+   the number of bytes used, which is less than len only if a callback
+   called gps_parser_stop() (or a batch filled up, see gps_batch.h) */
+size_t gps_parser_add_bytes(gps_parser_t *p, const char *data, size_t len);
+/* The same, noting rx_ns (say CLOCK_MONOTONIC when the bytes were read) as
+   the receive time of every sentence that ends in these bytes. It holds
+   for gps_parser_add_char() too, until the next call */
+size_t gps_parser_add_bytes_at(gps_parser_t *p, const char *data, size_t len, int64_t rx_ns);
+void   gps_parser_stop(gps_parser_t *p);
+
+/* Copies out the statistics. Call it from the thread feeding the parser */
+void gps_parser_stats(const gps_parser_t *p, gps_stats_t *stats);
+void gps_parser_stats_reset(gps_parser_t *p);
+/* Dates are taken to be no earlier than this (seconds since 1970). Older
+   receivers that have gone past a 1024 week GPS rollover report dates
+   19.6 years in the past, which are moved forward by whole rollovers */
+#ifndef GPS_EARLIEST_UTC
+#define GPS_EARLIEST_UTC 1577836800     /* 2020-01-01 */
+#endif
+void gps_parser_earliest_utc_set(gps_parser_t *p, int64_t seconds);
+/* Turns the parse time histogram on or off (off by default) */
+void gps_parser_timing_set(gps_parser_t *p, int enable);
+
+/* Sets the handler for a sentence type, replacing any existing one. A three
+   letter formatter ("GGA") applies to every talker (GP, GN, GL, GA, GB...),
+   while a full header ("GNGGA" or "PUBX") applies to just that sentence and
+   takes priority. A NULL handler makes the sentence unknown. GGA, GLL, GSA,
+   RMC, GSV and VTG are handled by default. Returns 0 if the table is full */
+int gps_parser_handler_set(gps_parser_t *p, const char *header, gps_sentence_handler_func handler);
+
+/****************************************************************************
+* Field access for sentence handlers (gps_field.c). Field 0 is the header.
+* Each returns 0 if the field is missing, badly formed or out of range
+* (too big for the type, minutes or seconds of 60 or more, an angle over
+* 180 degrees or a latitude over 90). Empty numeric fields read as zero.
+* Fields are read only up to their recorded length.
+****************************************************************************/
+#define GPS_MAX_LATITUDE_NDEG 90000000000ll
+const char *gps_field(            const gps_sentence_t *s, int fieldno, unsigned *len);
+int         gps_field_present(    const gps_sentence_t *s, int fieldno);
+int         gps_field_char(       const gps_sentence_t *s, int fieldno, char *dest, char *acceptible);
+int         gps_field_uint(       const gps_sentence_t *s, int fieldno, unsigned *dest);
+int         gps_field_double(     const gps_sentence_t *s, int fieldno, double *dest);
+/* The value as an integer mantissa and count of decimal places */
+int         gps_field_number(     const gps_sentence_t *s, int fieldno, int64_t *mantissa, int *decimals);
+/* The value times 10^decimals, rounded. value (if not NULL) gets the double */
+int         gps_field_scaled(     const gps_sentence_t *s, int fieldno, int decimals, int64_t *dest, double *value);
+/* A [d]ddmm.mmmm angle, in degrees */
+int         gps_field_angle(      const gps_sentence_t *s, int fieldno, double *dest);
+int         gps_field_angle_fixed(const gps_sentence_t *s, int fieldno, int64_t *ndeg, double *dest);
+/* An angle followed by its N/S or E/W field, negative for S and W */
+int         gps_field_position(   const gps_sentence_t *s, int fieldno, int64_t *ndeg, double *dest);
+/* A hhmmss.ss time, as milliseconds since midnight. Digits past the
+   millisecond are dropped, so only a leap second (ss = 60) reaches 86400000 */
+int         gps_field_time(       const gps_sentence_t *s, int fieldno, unsigned *ms, double *timestamp);
+/* Days from 1970-01-01 to a date in the Gregorian calendar */
+int64_t     gps_utc_days(int year, unsigned month, unsigned day);
+
+/****************************************************************************
+* UBX payload decoding (gps_ubx.c). Each returns 0 if the frame is the
+* wrong type or too short.
+****************************************************************************/
+int  gps_ubx_NAV_PVT(const gps_ubx_t *frame, gps_NAV_PVT_t *pvt);
+/* Fills in a fix. PVT has no horizontal or vertical DOP, so those are 0 */
+void gps_ubx_PVT_fix(const gps_NAV_PVT_t *pvt, gps_fix_t *fix);
+
+gps_parser_reject_callback_func gps_parser_reject_callback_set(gps_parser_t *p, gps_parser_reject_callback_func cb);
+/* The no fix callback is called when the receiver reports that it has no
+   fix (RMC or GLL status V, GGA quality 0 or no position, NAV-PVT without
+   gnssFixOK), and the fix acquired callback when it has one again. Each is
+   called once per change, not for every sentence. A fix counts as acquired
+   only once a sentence saying so (status A, quality above 0) has been
+   decoded without error. Sentences without a fix are not decoded any
+   further, and are counted in stats.no_fix */
+gps_parser_no_fix_callback_func gps_parser_no_fix_callback_set(gps_parser_t *p, gps_parser_no_fix_callback_func cb);
+gps_parser_fix_acquired_callback_func gps_parser_fix_acquired_callback_set(gps_parser_t *p, gps_parser_fix_acquired_callback_func cb);
+gps_parser_GPGGA_callback_func  gps_parser_GPGGA_callback_set( gps_parser_t *p, gps_parser_GPGGA_callback_func  cb);
+gps_parser_GPRMC_callback_func  gps_parser_GPRMC_callback_set( gps_parser_t *p, gps_parser_GPRMC_callback_func  cb);
+gps_parser_GPVTG_callback_func  gps_parser_GPVTG_callback_set( gps_parser_t *p, gps_parser_GPVTG_callback_func  cb);
+gps_parser_GPGLL_callback_func  gps_parser_GPGLL_callback_set( gps_parser_t *p, gps_parser_GPGLL_callback_func  cb);
+gps_GGA_callback_func    gps_parser_GGA_callback_set(   gps_parser_t *p, gps_GGA_callback_func    cb);
+gps_RMC_callback_func    gps_parser_RMC_callback_set(   gps_parser_t *p, gps_RMC_callback_func    cb);
+gps_GLL_callback_func    gps_parser_GLL_callback_set(   gps_parser_t *p, gps_GLL_callback_func    cb);
+gps_VTG_callback_func    gps_parser_VTG_callback_set(   gps_parser_t *p, gps_VTG_callback_func    cb);
+gps_GSA_callback_func    gps_parser_GSA_callback_set(   gps_parser_t *p, gps_GSA_callback_func    cb);
+/* UBX frames are picked out from between NMEA sentences. The frame callback
+   gets every one; NAV-PVT is also decoded for its own callback and, when
+   aggregating, merged into the fix for its time */
+gps_ubx_callback_func    gps_parser_ubx_callback_set(   gps_parser_t *p, gps_ubx_callback_func    cb);
+gps_NAV_PVT_callback_func gps_parser_NAV_PVT_callback_set(gps_parser_t *p, gps_NAV_PVT_callback_func cb);
+/* Sets the view callback for one type of sentence (not GPS_SENTENCE_OTHER -
+   those already go to their handler as a view). It is called before the
+   sentence is decoded, and if nothing else wants that type it is never
+   decoded at all. Returns the old callback */
+gps_view_callback_func   gps_parser_view_callback_set(  gps_parser_t *p, enum gps_sentence_type type, gps_view_callback_func cb);
+/* Called once per complete GSV sequence, with the whole satellite table */
+gps_GSV_callback_func    gps_parser_GSV_callback_set(   gps_parser_t *p, gps_GSV_callback_func    cb);
+/* Setting a fix callback turns on the epoch aggregator. GGA, RMC, GLL, VTG
+   and GSA are merged into one gps_fix_t per timestamp, which is passed on
+   when a sentence for a new time or one saying the fix is lost arrives, or
+   gps_parser_flush() is called. VTG and GSA sent while there is no fix are
+   not merged */
+gps_fix_callback_func    gps_parser_fix_callback_set(   gps_parser_t *p, gps_fix_callback_func    cb);
+void gps_parser_flush(gps_parser_t *p);
+
+/****************************************************************************
+* Single receiver API - these work on a shared default instance, with the
+* original callback signatures
+****************************************************************************/
 void gps_add_char(int c);
+size_t gps_add_bytes(const char *data, size_t len);
 
+/* The original callback types, without the user pointer */
 typedef void (*gps_reject_callback_func)(char *message, char *buffer);
 typedef void (*gps_no_fix_callback_func)(void);
+typedef void (*gps_fix_acquired_callback_func)(void);
 typedef void (*gps_GPGGA_callback_func)( unsigned fix_quality, unsigned no_of_sats, double   timestamp,
        double   latitude, char     latitude_ns, double   longitude, char     longitude_ew,
        double   altitude, char     alt_units,   double   hor_dop);
@@ -46,6 +582,7 @@ typedef void (*gps_GPGLL_callback_func)( double   timestamp, double   latitude,
 
 gps_reject_callback_func gps_reject_callback_set(gps_reject_callback_func cb);
 gps_no_fix_callback_func gps_no_fix_callback_set(gps_no_fix_callback_func cb);
+gps_fix_acquired_callback_func gps_fix_acquired_callback_set(gps_fix_acquired_callback_func cb);
 gps_GPGGA_callback_func  gps_GPGGA_callback_set(gps_GPGGA_callback_func cb);
 gps_GPRMC_callback_func  gps_GPRMC_callback_set(gps_GPRMC_callback_func cb);
 gps_GPVTG_callback_func  gps_GPVTG_callback_set(gps_GPVTG_callback_func cb);
@@ -0,0 +1,142 @@
+/******************************************************************************
+* gps_ring.c - lock-free single producer / single consumer queues
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <string.h>
+#include "gps_ring.h"
+
+/****************************************************************************/
+static int power_of_two(size_t size) {
+  return size != 0 && (size & (size-1)) == 0;
+}
+
+/****************************************************************************/
+int gps_byte_ring_init(gps_byte_ring_t *r, char *storage, size_t size) {
+  if(!power_of_two(size)) return 0;
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  r->tail_cache = 0;
+  r->head_cache = 0;
+  r->data       = storage;
+  r->mask       = size-1;
+  return 1;
+}
+
+/****************************************************************************/
+size_t gps_byte_ring_write(gps_byte_ring_t *r, const char *data, size_t len) {
+  size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  size_t size = r->mask + 1;
+  size_t space, offset, first;
+
+  space = size - (head - r->tail_cache);
+  if(space < len) {
+    r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+    space = size - (head - r->tail_cache);
+  }
+  if(len > space) len = space;
+  if(len == 0) return 0;
+
+  /* Copy in, wrapping around the end of the storage */
+  offset = head & r->mask;
+  first  = size - offset;
+  if(first > len) first = len;
+  memcpy(r->data + offset, data, first);
+  memcpy(r->data, data + first, len - first);
+
+  atomic_store_explicit(&r->head, head + len, memory_order_release);
+  return len;
+}
+
+/****************************************************************************/
+const char *gps_byte_ring_peek(gps_byte_ring_t *r, size_t *len) {
+  size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  size_t offset, avail;
+
+  if(r->head_cache == tail)
+    r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+  avail  = r->head_cache - tail;
+  offset = tail & r->mask;
+  if(avail > r->mask + 1 - offset)
+    avail = r->mask + 1 - offset;
+  *len = avail;
+  return r->data + offset;
+}
+
+/****************************************************************************/
+void gps_byte_ring_consume(gps_byte_ring_t *r, size_t len) {
+  size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  atomic_store_explicit(&r->tail, tail + len, memory_order_release);
+}
+
+/****************************************************************************/
+int gps_fix_queue_init(gps_fix_queue_t *q, gps_fix_t *storage, size_t size) {
+  if(!power_of_two(size)) return 0;
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  q->tail_cache = 0;
+  q->head_cache = 0;
+  q->dropped    = 0;
+  q->slot       = storage;
+  q->mask       = size-1;
+  return 1;
+}
+
+/****************************************************************************/
+int gps_fix_queue_push(gps_fix_queue_t *q, const gps_fix_t *fix) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+  if(head - q->tail_cache > q->mask) {
+    q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if(head - q->tail_cache > q->mask) {
+      q->dropped++;
+      return 0;
+    }
+  }
+  q->slot[head & q->mask] = *fix;
+  atomic_store_explicit(&q->head, head + 1, memory_order_release);
+  return 1;
+}
+
+/****************************************************************************/
+int gps_fix_queue_pop(gps_fix_queue_t *q, gps_fix_t *fix) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+  if(q->head_cache == tail) {
+    q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+    if(q->head_cache == tail) return 0;
+  }
+  *fix = q->slot[tail & q->mask];
+  atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+  return 1;
+}
+
+/****************************************************************************/
+void gps_fix_queue_callback(void *queue, const gps_fix_t *fix) {
+  gps_fix_queue_push(queue, fix);
+}
+/************************ End of file  ***************************************/
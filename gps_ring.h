@@ -0,0 +1,93 @@
+/******************************************************************************
+* gps_ring.h - lock-free single producer / single consumer queues
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef GPS_RING_H
+#define GPS_RING_H
+#include <stdatomic.h>
+#include "gps_parse.h"
+
+/****************************************************************************
+* Both queues are for exactly one producer thread and one consumer thread,
+* and use caller supplied storage whose size must be a power of two. Neither
+* side ever blocks or takes a lock: a write to a full queue and a read from
+* an empty one just return short.
+*
+* head is only written by the producer and tail only by the consumer, and
+* they are kept on separate cache lines so the two threads don't fight over
+* them. Each side keeps a private copy of the other's index and only loads
+* the shared one again when its copy says the queue is full (or empty).
+****************************************************************************/
+#define GPS_RING_ALIGN 64
+
+typedef struct gps_byte_ring {
+  _Alignas(GPS_RING_ALIGN) atomic_size_t head;
+  size_t        tail_cache;   /* producer's copy of tail */
+  _Alignas(GPS_RING_ALIGN) atomic_size_t tail;
+  size_t        head_cache;   /* consumer's copy of head */
+  _Alignas(GPS_RING_ALIGN) char *data;
+  size_t        mask;
+} gps_byte_ring_t;
+
+/* Returns 0 if size is not a power of two */
+int    gps_byte_ring_init(gps_byte_ring_t *r, char *storage, size_t size);
+
+/* Producer: copies in as much as fits, returning the number of bytes */
+size_t gps_byte_ring_write(gps_byte_ring_t *r, const char *data, size_t len);
+
+/* Consumer: the readable bytes up to the end of the storage, in place, so
+   they can go straight to gps_parser_add_bytes(). Release them with
+   gps_byte_ring_consume(). */
+const char *gps_byte_ring_peek(gps_byte_ring_t *r, size_t *len);
+void   gps_byte_ring_consume(gps_byte_ring_t *r, size_t len);
+
+/****************************************************************************/
+typedef struct gps_fix_queue {
+  _Alignas(GPS_RING_ALIGN) atomic_size_t head;
+  size_t        tail_cache;
+  unsigned long dropped;      /* pushes refused because the queue was full */
+  _Alignas(GPS_RING_ALIGN) atomic_size_t tail;
+  size_t        head_cache;
+  _Alignas(GPS_RING_ALIGN) gps_fix_t *slot;
+  size_t        mask;
+} gps_fix_queue_t;
+
+/* Returns 0 if size is not a power of two */
+int  gps_fix_queue_init(gps_fix_queue_t *q, gps_fix_t *storage, size_t size);
+
+/* Producer: returns 0 (and counts a drop) if the queue is full */
+int  gps_fix_queue_push(gps_fix_queue_t *q, const gps_fix_t *fix);
+
+/* Consumer: returns 0 if the queue is empty */
+int  gps_fix_queue_pop(gps_fix_queue_t *q, gps_fix_t *fix);
+
+/* A gps_fix_callback_func that pushes, for a parser whose user pointer is
+   the queue */
+void gps_fix_queue_callback(void *queue, const gps_fix_t *fix);
+#endif
+/************************ End of file  ***************************************/
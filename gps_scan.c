@@ -0,0 +1,196 @@
+/******************************************************************************
+* gps_scan.c - vectorised scanning of NMEA sentence bodies
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include "gps_scan.h"
+
+/* SSE2 is always there on x86-64, AVX2 is picked at runtime */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(GPS_NO_SIMD)
+#define GPS_SCAN_X86
+#include <immintrin.h>
+#endif
+
+/****************************************************************************/
+/* Bit 0 strict, bit 1 lenient, bit 2 hex digit (see gps_scan.h)            */
+/****************************************************************************/
+const unsigned char gps_char_class[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0x00 */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0x10 */
+  3, 2, 3, 3, 0, 3, 3, 3, 3, 3, 0, 3, 3, 3, 3, 3,   /* 0x20 */
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 3, 3, 3, 3, 3, 3,   /* 0x30 */
+  3, 7, 7, 7, 7, 7, 7, 3, 3, 3, 3, 3, 3, 3, 3, 3,   /* 0x40 */
+  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 3, 2, 3,   /* 0x50 */
+  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,   /* 0x60 */
+  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 0,   /* 0x70 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0x80 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0x90 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0xA0 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0xB0 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0xC0 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0xD0 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0xE0 */
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2    /* 0xF0 */
+};
+
+/****************************************************************************/
+size_t gps_scan_scalar(const char *data, size_t len, char *checksum,
+                       unsigned short *commas, unsigned *ncommas, unsigned max_commas,
+                       unsigned charset) {
+  size_t   i;
+  unsigned n = 0;
+  char     x = *checksum;
+
+  for(i = 0; i < len; i++) {
+    char c = data[i];
+    if(!GPS_IS_NMEA_CHAR(c, charset)) break;
+    if(c == ',') {
+      if(n == max_commas) break;
+      commas[n++] = i;
+    }
+    x ^= c;
+  }
+  *checksum = x;
+  *ncommas  = n;
+  return i;
+}
+
+#ifdef GPS_SCAN_X86
+/****************************************************************************/
+/* Finish off after the vector loop: fold the XOR accumulator down to one   */
+/* byte and let the scalar code deal with the rest. The vector loops only   */
+/* pass the characters that every set allows (0-9, A-Z, ',', '.' and '-'),  */
+/* so anything else is left to the table. Always inlined, so the AVX2 copy  */
+/* doesn't call SSE code with the upper halves of the registers dirty       */
+/****************************************************************************/
+static inline __attribute__((always_inline))
+size_t scan_tail(const char *data, size_t len, char *checksum,
+                        unsigned short *commas, unsigned *ncommas, unsigned max_commas,
+                        unsigned charset, size_t i, unsigned n, __m128i acc) {
+  unsigned m, k;
+
+  acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+  acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+  acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 2));
+  acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 1));
+  *checksum ^= (char)_mm_cvtsi128_si32(acc);
+
+  len = i + gps_scan_scalar(data+i, len-i, checksum, commas+n, &m, max_commas-n, charset);
+  for(k = 0; k < m; k++)
+    commas[n+k] += i;
+  *ncommas = n+m;
+  return len;
+}
+
+/****************************************************************************/
+static size_t scan_sse2(const char *data, size_t len, char *checksum,
+                        unsigned short *commas, unsigned *ncommas, unsigned max_commas,
+                        unsigned charset) {
+  const __m128i below_0 = _mm_set1_epi8('0'-1), above_9 = _mm_set1_epi8('9'+1);
+  const __m128i below_A = _mm_set1_epi8('A'-1), above_Z = _mm_set1_epi8('Z'+1);
+  const __m128i comma   = _mm_set1_epi8(','),   dot     = _mm_set1_epi8('.');
+  const __m128i minus   = _mm_set1_epi8('-');
+  __m128i  acc = _mm_setzero_si128();
+  size_t   i = 0;
+  unsigned n = 0;
+
+  while(i+16 <= len) {
+    __m128i  v = _mm_loadu_si128((const __m128i *)(data+i));
+    __m128i  is_comma = _mm_cmpeq_epi8(v, comma);
+    __m128i  ok;
+    unsigned cmask;
+
+    /* Bytes >= 0x80 are negative, so fail both range checks */
+    ok = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(v, below_0), _mm_cmplt_epi8(v, above_9)),
+                      _mm_and_si128(_mm_cmpgt_epi8(v, below_A), _mm_cmplt_epi8(v, above_Z)));
+    ok = _mm_or_si128(ok, _mm_or_si128(is_comma, _mm_cmpeq_epi8(v, dot)));
+    ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, minus));
+    if(_mm_movemask_epi8(ok) != 0xFFFF) break;
+
+    cmask = _mm_movemask_epi8(is_comma);
+    if(n + __builtin_popcount(cmask) > max_commas) break;
+    while(cmask) {
+      commas[n++] = i + __builtin_ctz(cmask);
+      cmask &= cmask-1;
+    }
+    acc = _mm_xor_si128(acc, v);
+    i += 16;
+  }
+  return scan_tail(data, len, checksum, commas, ncommas, max_commas, charset, i, n, acc);
+}
+
+/****************************************************************************/
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *data, size_t len, char *checksum,
+                        unsigned short *commas, unsigned *ncommas, unsigned max_commas,
+                        unsigned charset) {
+  const __m256i below_0 = _mm256_set1_epi8('0'-1), above_9 = _mm256_set1_epi8('9'+1);
+  const __m256i below_A = _mm256_set1_epi8('A'-1), above_Z = _mm256_set1_epi8('Z'+1);
+  const __m256i comma   = _mm256_set1_epi8(','),   dot     = _mm256_set1_epi8('.');
+  const __m256i minus   = _mm256_set1_epi8('-');
+  __m256i  acc = _mm256_setzero_si256();
+  size_t   i = 0;
+  unsigned n = 0;
+
+  while(i+32 <= len) {
+    __m256i  v = _mm256_loadu_si256((const __m256i *)(data+i));
+    __m256i  is_comma = _mm256_cmpeq_epi8(v, comma);
+    __m256i  ok;
+    unsigned cmask;
+
+    ok = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi8(v, below_0), _mm256_cmpgt_epi8(above_9, v)),
+                         _mm256_and_si256(_mm256_cmpgt_epi8(v, below_A), _mm256_cmpgt_epi8(above_Z, v)));
+    ok = _mm256_or_si256(ok, _mm256_or_si256(is_comma, _mm256_cmpeq_epi8(v, dot)));
+    ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, minus));
+    if((unsigned)_mm256_movemask_epi8(ok) != 0xFFFFFFFFu) break;
+
+    cmask = _mm256_movemask_epi8(is_comma);
+    if(n + __builtin_popcount(cmask) > max_commas) break;
+    while(cmask) {
+      commas[n++] = i + __builtin_ctz(cmask);
+      cmask &= cmask-1;
+    }
+    acc = _mm256_xor_si256(acc, v);
+    i += 32;
+  }
+  return scan_tail(data, len, checksum, commas, ncommas, max_commas, charset, i, n,
+                   _mm_xor_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+}
+#endif
+
+/****************************************************************************/
+gps_scan_func gps_scan_select(void) {
+#ifdef GPS_SCAN_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+    return scan_avx2;
+  return scan_sse2;
+#else
+  return gps_scan_scalar;
+#endif
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,69 @@
+/******************************************************************************
+* gps_scan.h - vectorised scanning of NMEA sentence bodies
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#ifndef GPS_SCAN_H
+#define GPS_SCAN_H
+#include <stddef.h>
+
+/****************************************************************************
+* Every byte is classified by a 256 entry table. A character set is a mask
+* of the class bits, picking the characters allowed in the body of a
+* sentence:
+*   GPS_CHARSET_STRICT  - printable ASCII except the NMEA 0183 reserved
+*                         characters $ * ! \ ^ ~ (the NMEA 4.x set)
+*   GPS_CHARSET_LENIENT - any byte but control characters, '$' and '*'
+****************************************************************************/
+#define GPS_CHARSET_STRICT  0x01
+#define GPS_CHARSET_LENIENT 0x02
+#define GPS_CHAR_HEX        0x04    /* 0-9 and A-F, for the checksum */
+
+extern const unsigned char gps_char_class[256];
+
+#define GPS_IS_NMEA_CHAR(c, charset) (gps_char_class[(unsigned char)(c)] & (charset))
+
+/****************************************************************************
+* A scan function measures the run of sentence characters (those in
+* charset) at the start of data (at most len bytes), XORs them into
+* *checksum, and writes the offset of every comma in the run to commas[],
+* setting *ncommas. The run stops at the first byte that is not a sentence
+* character (so '*', '\r' and '\n' all end it), or before a comma that
+* would not fit in max_commas. The length of the run is returned.
+****************************************************************************/
+typedef size_t (*gps_scan_func)(const char *data, size_t len, char *checksum,
+                                unsigned short *commas, unsigned *ncommas,
+                                unsigned max_commas, unsigned charset);
+
+/* Pick the fastest implementation the CPU supports */
+gps_scan_func gps_scan_select(void);
+
+size_t gps_scan_scalar(const char *data, size_t len, char *checksum,
+                       unsigned short *commas, unsigned *ncommas, unsigned max_commas,
+                       unsigned charset);
+#endif
+/************************ End of file  ***************************************/
@@ -0,0 +1,128 @@
+/******************************************************************************
+* gps_ubx.c - u-blox UBX payload decoding
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <string.h>
+#include "gps_parse.h"
+
+/****************************************************************************/
+/* UBX is little-endian throughout                                          */
+/****************************************************************************/
+static uint16_t u2(const unsigned char *p) {
+  return (uint16_t)(p[0] | p[1]<<8);
+}
+
+static uint32_t u4(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1]<<8 | (uint32_t)p[2]<<16 | (uint32_t)p[3]<<24;
+}
+
+static int32_t i4(const unsigned char *p) {
+  return (int32_t)u4(p);
+}
+
+/****************************************************************************/
+int gps_ubx_NAV_PVT(const gps_ubx_t *frame, gps_NAV_PVT_t *pvt) {
+  const unsigned char *d = frame->payload;
+
+  /* 84 bytes in older protocol versions, 92 now - pDOP is in both */
+  if(frame->msg_class != GPS_UBX_NAV || frame->msg_id != GPS_UBX_NAV_PVT) return 0;
+  if(frame->length < 78) return 0;
+
+  pvt->itow         = u4(d+0);
+  pvt->year         = u2(d+4);
+  pvt->month        = d[6];
+  pvt->day          = d[7];
+  pvt->hour         = d[8];
+  pvt->min          = d[9];
+  pvt->sec          = d[10];
+  pvt->valid        = d[11];
+  pvt->time_acc     = u4(d+12);
+  pvt->nano         = i4(d+16);
+  pvt->fix_type     = d[20];
+  pvt->flags        = d[21];
+  pvt->num_sv       = d[23];
+  pvt->longitude    = i4(d+24);
+  pvt->latitude     = i4(d+28);
+  pvt->height       = i4(d+32);
+  pvt->height_msl   = i4(d+36);
+  pvt->hor_acc      = u4(d+40);
+  pvt->vert_acc     = u4(d+44);
+  pvt->vel_n        = i4(d+48);
+  pvt->vel_e        = i4(d+52);
+  pvt->vel_d        = i4(d+56);
+  pvt->ground_speed = i4(d+60);
+  pvt->heading      = i4(d+64);
+  pvt->speed_acc    = u4(d+68);
+  pvt->heading_acc  = u4(d+72);
+  pvt->pos_dop      = u2(d+76);
+  return 1;
+}
+
+/****************************************************************************/
+void gps_ubx_PVT_fix(const gps_NAV_PVT_t *pvt, gps_fix_t *fix) {
+  memset(fix, 0, sizeof(*fix));
+
+  /* Fields out of range are treated as not valid */
+  if((pvt->valid & GPS_PVT_VALID_TIME) && pvt->hour < 24 && pvt->min < 60 && pvt->sec <= 60
+     && pvt->nano > -1000000000 && pvt->nano < 1000000000) {
+    /* nano can be negative, when sec has been rounded up */
+    int64_t ns = ((int64_t)pvt->hour*3600 + pvt->min*60 + pvt->sec) * 1000000000 + pvt->nano;
+    if(ns < 0) ns = 0;
+    fix->time_ms = (unsigned)((ns + 500000) / 1000000);
+    fix->have   |= GPS_FIX_TIME;
+  }
+  if((pvt->valid & GPS_PVT_VALID_DATE) && pvt->day >= 1 && pvt->day <= 31
+     && pvt->month >= 1 && pvt->month <= 12) {
+    fix->date  = pvt->day*10000u + pvt->month*100u + pvt->year%100u;
+    fix->have |= GPS_FIX_DATE;
+  }
+  if((fix->have & GPS_FIX_TIME) && (fix->have & GPS_FIX_DATE)) {
+    fix->utc_ns = gps_utc_days(pvt->year, pvt->month, pvt->day) * 86400000000000ll
+                + ((int64_t)pvt->hour*3600 + pvt->min*60 + pvt->sec) * 1000000000 + pvt->nano;
+    fix->have  |= GPS_FIX_UTC;
+  }
+
+  fix->fix_type = pvt->fix_type == 2 ? 2 : pvt->fix_type == 3 || pvt->fix_type == 4 ? 3 : 1;
+  fix->pos_dop  = pvt->pos_dop * 0.01;
+  fix->have    |= GPS_FIX_DOP;
+  if(!(pvt->flags & GPS_PVT_GNSS_FIX_OK)) return;
+  if(pvt->latitude  > 900000000 || pvt->latitude  < -900000000) return;
+  if(pvt->longitude > 1800000000 || pvt->longitude < -1800000000) return;
+
+  fix->latitude_ndeg  = (int64_t)pvt->latitude  * 100;
+  fix->longitude_ndeg = (int64_t)pvt->longitude * 100;
+  fix->latitude       = pvt->latitude  * 1e-7;
+  fix->longitude      = pvt->longitude * 1e-7;
+  fix->altitude       = pvt->height_msl * 0.001;
+  fix->speed_knots    = pvt->ground_speed * (3.6 / 1852.0);
+  fix->course         = pvt->heading * 1e-5;
+  fix->fix_quality    = pvt->flags & GPS_PVT_DIFF_SOLN ? 2 : 1;
+  fix->no_of_sats     = pvt->num_sv;
+  fix->have          |= GPS_FIX_POSITION | GPS_FIX_ALTITUDE | GPS_FIX_VELOCITY | GPS_FIX_QUALITY;
+}
+/************************ End of file  ***************************************/
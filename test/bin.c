@@ -0,0 +1,91 @@
+/******************************************************************************
+* bin.c - tests for the gps_bin record conversions
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "../gps_bin.h"
+
+/*****************************************************************************
+* Built with -fsanitize=undefined (make test does), so a value converted
+* out of range stops the run as well as failing a check.
+*****************************************************************************/
+static int failures;
+
+static void check_course(double course, unsigned expect) {
+  gps_bin_record_t r;
+  gps_fix_t        fix;
+  gps_RMC_t        rmc;
+  gps_VTG_t        vtg;
+
+  memset(&fix, 0, sizeof(fix));
+  memset(&rmc, 0, sizeof(rmc));
+  memset(&vtg, 0, sizeof(vtg));
+  fix.course      = course;
+  rmc.course      = course;
+  vtg.course_true = course;
+
+  gps_bin_from_fix(&r, &fix);
+  if(r.course != expect) {
+    printf("fix course %g encoded as %u, not %u\n", course, r.course, expect);
+    failures++;
+  }
+  gps_bin_from_RMC(&r, &rmc);
+  if(r.course != expect) {
+    printf("RMC course %g encoded as %u, not %u\n", course, r.course, expect);
+    failures++;
+  }
+  gps_bin_from_VTG(&r, &vtg);
+  if(r.course != expect) {
+    printf("VTG course %g encoded as %u, not %u\n", course, r.course, expect);
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+int main(void) {
+  check_course(0,        0);
+  check_course(45.25,    4525);
+  check_course(359.99,   35999);
+  check_course(359.999,  0);
+  check_course(360,      0);
+  check_course(-0.001,   0);
+  check_course(-90,      27000);
+  check_course(-499.5,   22050);
+  check_course(655.36,   29536);
+  check_course(99999,    27900);
+  check_course(1e300,    (unsigned)(fmod(1e300, 360.0) * 100 + 0.5));
+  check_course(INFINITY, 0);
+  check_course(NAN,      0);
+
+  if(failures) return 1;
+  printf("gps_bin conversions ok\n");
+  return 0;
+}
+/************************ End of file  ***************************************/
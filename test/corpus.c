@@ -0,0 +1,197 @@
+/******************************************************************************
+* corpus.c - what the parser makes of each fuzz corpus file
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include "../gps_parse.h"
+
+/*****************************************************************************
+* The fuzz harness only checks that add_char() and add_bytes() agree, so
+* this checks that each file in fuzz/corpus comes out the way it is meant
+* to: how many sentences were accepted, how many said there was no fix, and
+* how many were rejected for each reason. The first byte of a file picks
+* the options just as it does for the harness. A file with no entry here
+* fails, so every new seed gets its expected outcome written down.
+*****************************************************************************/
+#define CORPUS "fuzz/corpus"
+
+struct expect {
+  const char *file;
+  unsigned    accepted;
+  unsigned    no_fix;
+  unsigned    rejected[GPS_REJECT_REASONS];
+};
+
+static const struct expect expects[] = {
+  /*  file                     ok  nofix  cksum long fields unknown parse */
+  { "bad_chars.nmea",          2,  0, {  1,   0,   0,     0,      0 } },
+  { "bad_checksum.nmea",       1,  0, {  1,   0,   0,     0,      0 } },
+  { "charset.nmea",            2,  0, {  0,   0,   0,     2,      0 } },
+  /* The RMC and GGA after a sentence cut off by a newline */
+  { "cut_off.nmea",            2,  0, {  0,   0,   0,     0,      0 } },
+  { "empty_fields.nmea",       5,  3, {  0,   0,   0,     2,      1 } },
+  { "huge_numbers.nmea",       1,  0, {  0,   0,   0,     0,      3 } },
+  { "latitude_over_90.nmea",   0,  0, {  0,   0,   0,     0,      2 } },
+  /* A 15 character sentence fits a GPS_MIN_BUFFER_SIZE buffer, 16 don't */
+  { "min_buffer.nmea",         3,  1, {  0,   2,   0,     0,      0 } },
+  { "minutes_60.nmea",         0,  0, {  0,   0,   0,     0,      2 } },
+  { "negative.nmea",           0,  0, {  0,   0,   0,     0,      2 } },
+  { "no_fix.nmea",             8,  5, {  0,   0,   0,     0,      0 } },
+  { "no_fix_epoch.nmea",      10,  3, {  0,   0,   0,     0,      1 } },
+  /* The RMC that starts in the middle of a GGA */
+  { "split_sentence.nmea",     1,  0, {  0,   0,   0,     0,      0 } },
+  /* Hours 25, minutes 61, day 32 and month 13; second 60 is a leap second */
+  { "time_range.nmea",         1,  0, {  0,   0,   0,     0,      4 } },
+  { "time_round.nmea",         5,  0, {  0,   0,   0,     0,      1 } },
+  { "too_long.nmea",           1,  0, {  0,   1,   0,     0,      0 } },
+  { "too_many_fields.nmea",    1,  0, {  0,   0,   1,     0,      0 } },
+  { "ubx_false_sync.nmea",     7,  0, {  0,   2,   0,     0,      0 } },
+  { "ubx_pvt.bin",             4,  0, {  0,   0,   0,     0,      0 } },
+  { "ubx_truncated.bin",       2,  0, {  1,   1,   0,     0,      0 } },
+  { "valid_mix.nmea",          8,  0, {  0,   0,   0,     1,      0 } },
+  { NULL }
+};
+
+static int failures;
+
+static void on_GGA(void *user, const gps_GGA_t *gga) { }
+static void on_RMC(void *user, const gps_RMC_t *rmc) { }
+static void on_GLL(void *user, const gps_GLL_t *gll) { }
+static void on_VTG(void *user, const gps_VTG_t *vtg) { }
+static void on_GSA(void *user, const gps_GSA_t *gsa) { }
+static void on_GSV(void *user, const gps_sky_t *sky) { }
+static void on_PVT(void *user, const gps_NAV_PVT_t *pvt) { }
+
+/*****************************************************************************/
+static const struct expect *find(const char *file) {
+  const struct expect *e;
+
+  for(e = expects; e->file != NULL; e++)
+    if(strcmp(e->file, file) == 0) return e;
+  return NULL;
+}
+
+/*****************************************************************************/
+static void check_file(const char *file) {
+  static unsigned char data[1<<16];
+  static char          buffer[512];
+  const struct expect *e = find(file);
+  gps_parser_t         p;
+  gps_stats_t          st;
+  char                 path[4096];
+  unsigned             accepted = 0, i;
+  size_t               len;
+  FILE                *f;
+
+  snprintf(path, sizeof(path), "%s/%s", CORPUS, file);
+  f = fopen(path, "rb");
+  if(f == NULL) {
+    printf("%s: unable to open\n", path);
+    failures++;
+    return;
+  }
+  len = fread(data, 1, sizeof(data), f);
+  fclose(f);
+
+  /* The same options as fuzz.c takes from the first byte */
+  gps_parser_init(&p, NULL);
+  if(len > 0 && (data[0] & 1))
+    gps_parser_charset_set(&p, GPS_CHARSET_LENIENT);
+  if(len > 0 && (data[0] & 2))
+    gps_parser_buffer_set(&p, buffer, data[0] & 4 ? GPS_MIN_BUFFER_SIZE : 512);
+  gps_parser_GGA_callback_set(&p, on_GGA);
+  gps_parser_RMC_callback_set(&p, on_RMC);
+  gps_parser_GLL_callback_set(&p, on_GLL);
+  gps_parser_VTG_callback_set(&p, on_VTG);
+  gps_parser_GSA_callback_set(&p, on_GSA);
+  gps_parser_GSV_callback_set(&p, on_GSV);
+  gps_parser_NAV_PVT_callback_set(&p, on_PVT);
+  gps_parser_add_bytes(&p, (const char *)data, len);
+  gps_parser_stats(&p, &st);
+
+  for(i = 0; i < GPS_SENTENCE_TYPES; i++)
+    accepted += st.accepted[i];
+  if(e == NULL) {
+    printf("%s: no expected outcome, got { \"%s\", %u, %u, { %u, %u, %u, %u, %u } }\n", path, file,
+           accepted, (unsigned)st.no_fix, (unsigned)st.rejected[0], (unsigned)st.rejected[1],
+           (unsigned)st.rejected[2], (unsigned)st.rejected[3], (unsigned)st.rejected[4]);
+    failures++;
+    return;
+  }
+  if(accepted != e->accepted) {
+    printf("%s: %u sentences accepted, not %u\n", path, accepted, e->accepted);
+    failures++;
+  }
+  if(st.no_fix != e->no_fix) {
+    printf("%s: %u without a fix, not %u\n", path, (unsigned)st.no_fix, e->no_fix);
+    failures++;
+  }
+  for(i = 0; i < GPS_REJECT_REASONS; i++) {
+    if(st.rejected[i] != e->rejected[i]) {
+      printf("%s: %u rejected for reason %u, not %u\n", path, (unsigned)st.rejected[i], i, e->rejected[i]);
+      failures++;
+    }
+  }
+}
+
+/*****************************************************************************/
+int main(void) {
+  const struct expect *e;
+  DIR                 *dir = opendir(CORPUS);
+  struct dirent       *d;
+
+  if(dir == NULL) {
+    printf("Unable to open %s\n", CORPUS);
+    return 1;
+  }
+  while((d = readdir(dir)) != NULL) {
+    if(d->d_name[0] == '.') continue;
+    check_file(d->d_name);
+  }
+  closedir(dir);
+
+  /* And the other way round, so a seed can't go missing unnoticed */
+  for(e = expects; e->file != NULL; e++) {
+    char  path[4096];
+    FILE *f;
+    snprintf(path, sizeof(path), "%s/%s", CORPUS, e->file);
+    if((f = fopen(path, "rb")) == NULL) {
+      printf("%s: missing\n", path);
+      failures++;
+    } else {
+      fclose(f);
+    }
+  }
+
+  if(failures) return 1;
+  printf("fuzz corpus decodes as expected\n");
+  return 0;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,24 @@
+#!/bin/sh
+###############################################################################
+# decode_chunks.sh - example/decode must give the same output whatever size
+# of chunk the log is cut into, in CSV and in binary
+###############################################################################
+set -e
+cd "$(dirname "$0")/.."
+log=test/chunks.nmea
+trap 'rm -f $log $log.ref $log.out' EXIT
+
+for gen in "-S 1" "-S 2 -F 0.3" "-S 3 -e 0.02" "-S 4 -G 0.1"; do
+  ./bench/bench -g -n 400000 $gen > $log
+  for format in "" -b; do
+    ./example/decode $format -t 1 -c 100000000 $log > $log.ref
+    for chunk in 1 100 1000 4096 65536; do
+      ./example/decode $format -t 4 -c $chunk $log > $log.out
+      if ! cmp -s $log.ref $log.out; then
+        echo "decode $format -c $chunk differs from one chunk (bench -g $gen)"
+        exit 1
+      fi
+    done
+  done
+done
+echo "decode output is the same for every chunk size"
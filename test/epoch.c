@@ -0,0 +1,177 @@
+/******************************************************************************
+* epoch.c - sentences for the same time merged into one fix
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "../gps_parse.h"
+
+/*****************************************************************************
+* Runs of sentences are fed to a parser with a fix callback, and the fixes
+* they are merged into are checked field by field.
+*****************************************************************************/
+#define MAX_FIXES 8
+
+static int       failures;
+static gps_fix_t fixes[MAX_FIXES];
+static int       nfixes;
+
+static void on_fix(void *user, const gps_fix_t *fix) {
+  if(nfixes < MAX_FIXES)
+    fixes[nfixes] = *fix;
+  nfixes++;
+}
+
+/*****************************************************************************/
+static void send(gps_parser_t *p, const char *body, int64_t rx_ns) {
+  char          line[128];
+  unsigned char checksum = 0;
+  const char   *c;
+
+  for(c = body; *c; c++)
+    checksum ^= (unsigned char)*c;
+  snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+  gps_parser_add_bytes_at(p, line, strlen(line), rx_ns);
+}
+
+/*****************************************************************************/
+static void check(const char *what, long long got, long long expect) {
+  if(got != expect) {
+    printf("%s: %lld, not %lld\n", what, got, expect);
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+static void check_double(const char *what, double got, double expect) {
+  if(got != expect) {
+    printf("%s: %g, not %g\n", what, got, expect);
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+static void init(gps_parser_t *p) {
+  gps_parser_init(p, NULL);
+  gps_parser_fix_callback_set(p, on_fix);
+  gps_parser_add_char(p, '\n');
+  nfixes = 0;
+}
+
+/*****************************************************************************/
+/* GGA, GSA, RMC and VTG for one time make one fix                          */
+/*****************************************************************************/
+static void check_merge(void) {
+  gps_parser_t p;
+  gps_fix_t   *f = &fixes[0];
+
+  init(&p);
+  send(&p, "GPGGA,123519.00,4807.038,N,01131.000,E,2,08,0.9,545.4,M,46.9,M,,", 100);
+  send(&p, "GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1", 200);
+  send(&p, "GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W", 300);
+  send(&p, "GPVTG,054.7,T,034.4,M,005.5,N,010.2,K", 400);
+  check("fixes before the epoch ends", nfixes, 0);
+  gps_parser_flush(&p);
+  check("fixes", nfixes, 1);
+
+  check("have", f->have, GPS_FIX_TIME | GPS_FIX_POSITION | GPS_FIX_ALTITUDE | GPS_FIX_QUALITY
+                         | GPS_FIX_VELOCITY | GPS_FIX_DATE | GPS_FIX_DOP | GPS_FIX_UTC);
+  check("time_ms", f->time_ms, 45319000);
+  check("rx_ns", f->rx_ns, 100);
+  check("latitude_ndeg", f->latitude_ndeg, 48117300000LL);
+  check("longitude_ndeg", f->longitude_ndeg, 11516666667LL);
+  check("talker", strcmp(f->talker, "GP"), 0);
+  check_double("altitude", f->altitude, 545.4);
+  check("fix_quality", f->fix_quality, 2);
+  check("no_of_sats", f->no_of_sats, 8);
+  check("date", f->date, 230394);
+  check("fix_type", f->fix_type, 3);
+  check_double("pos_dop", f->pos_dop, 2.5);
+  check_double("hor_dop from GSA", f->hor_dop, 1.3);
+  check_double("vert_dop", f->vert_dop, 2.1);
+  check_double("speed from VTG", f->speed_knots, 5.5);
+  check_double("course from VTG", f->course, 54.7);
+}
+
+/*****************************************************************************/
+/* A sentence for a new time passes on the epoch before it                  */
+/*****************************************************************************/
+static void check_new_time(void) {
+  gps_parser_t p;
+
+  init(&p);
+  send(&p, "GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 100);
+  send(&p, "GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W", 200);
+  send(&p, "GPGGA,123520.00,4807.040,N,01131.000,E,1,08,0.9,545.6,M,46.9,M,,", 300);
+  check("fixes after a new time", nfixes, 1);
+  check("first time_ms", fixes[0].time_ms, 45319000);
+  check("first has a date", (fixes[0].have & GPS_FIX_DATE) != 0, 1);
+  check_double("first speed from RMC", fixes[0].speed_knots, 22.4);
+
+  send(&p, "GPGLL,4807.042,N,01131.000,E,123521.00,A", 400);
+  check("fixes after GLL", nfixes, 2);
+  check("second time_ms", fixes[1].time_ms, 45320000);
+  check("second rx_ns", fixes[1].rx_ns, 300);
+  check("second has no date", (fixes[1].have & GPS_FIX_DATE) != 0, 0);
+  check_double("second altitude", fixes[1].altitude, 545.6);
+
+  gps_parser_flush(&p);
+  check("fixes after the flush", nfixes, 3);
+  check("GLL have", fixes[2].have, GPS_FIX_TIME | GPS_FIX_POSITION | GPS_FIX_UTC);
+  check("GLL latitude_ndeg", fixes[2].latitude_ndeg, 48117366667LL);
+  gps_parser_flush(&p);
+  check("fixes after a second flush", nfixes, 3);
+}
+
+/*****************************************************************************/
+/* Untimed sentences before any epoch opens are a fix of their own          */
+/*****************************************************************************/
+static void check_untimed(void) {
+  gps_parser_t p;
+
+  init(&p);
+  send(&p, "GPVTG,054.7,T,034.4,M,005.5,N,010.2,K", 100);
+  send(&p, "GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 200);
+  gps_parser_flush(&p);
+  check("untimed fixes", nfixes, 2);
+  check("untimed have", fixes[0].have, GPS_FIX_VELOCITY);
+  check("timed has no velocity", (fixes[1].have & GPS_FIX_VELOCITY) != 0, 0);
+  check("timed rx_ns", fixes[1].rx_ns, 200);
+}
+
+/*****************************************************************************/
+int main(void) {
+  check_merge();
+  check_new_time();
+  check_untimed();
+
+  if(failures) return 1;
+  printf("epochs ok\n");
+  return 0;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,176 @@
+/******************************************************************************
+* fix_state.c - the no fix and fix acquired callbacks
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "../gps_parse.h"
+
+/*****************************************************************************
+* Each callback adds a letter to a log, N for no fix, A for fix acquired and
+* F for a fix, and the log is checked after each group of sentences.
+*****************************************************************************/
+static int       failures;
+static char      events[64];
+static gps_fix_t last_fix;
+
+static void note(char c) {
+  size_t n = strlen(events);
+  if(n < sizeof(events)-1) {
+    events[n]   = c;
+    events[n+1] = '\0';
+  }
+}
+
+static void on_no_fix(void *user)                        { note('N'); }
+static void on_fix_acquired(void *user)                  { note('A'); }
+static void on_fix(void *user, const gps_fix_t *fix)     { note('F'); last_fix = *fix; }
+
+/*****************************************************************************/
+static void send(gps_parser_t *p, const char *body) {
+  char          line[128];
+  unsigned char checksum = 0;
+  const char   *c;
+
+  for(c = body; *c; c++)
+    checksum ^= (unsigned char)*c;
+  snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+  gps_parser_add_bytes(p, line, strlen(line));
+}
+
+/*****************************************************************************/
+static void check(const char *what, const char *expect) {
+  if(strcmp(events, expect) != 0) {
+    printf("%s: \"%s\", not \"%s\"\n", what, events, expect);
+    failures++;
+  }
+  events[0] = '\0';
+}
+
+/*****************************************************************************/
+static void check_value(const char *what, long got, long expect) {
+  if(got != expect) {
+    printf("%s: %ld, not %ld\n", what, got, expect);
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+static void init(gps_parser_t *p, int aggregate) {
+  gps_parser_init(p, NULL);
+  gps_parser_no_fix_callback_set(p, on_no_fix);
+  gps_parser_fix_acquired_callback_set(p, on_fix_acquired);
+  if(aggregate)
+    gps_parser_fix_callback_set(p, on_fix);
+  gps_parser_add_char(p, '\n');
+  events[0] = '\0';
+}
+
+/*****************************************************************************/
+/* Each callback is made once per change, whichever sentence says so       */
+/*****************************************************************************/
+static void check_changes(void) {
+  gps_parser_t p;
+
+  init(&p, 0);
+  send(&p, "GPGGA,120000,,,,,0,00,,,M,,M,,");
+  check("GGA without a fix", "N");
+  send(&p, "GPRMC,120000,V,,,,,,,010125,,");
+  send(&p, "GPGLL,,,,,120000,V");
+  send(&p, "GPGGA,120001,,,,,0,00,,,M,,M,,");
+  check("still no fix", "");
+  check_value("no_fix", (long)p.stats.no_fix, 4);
+
+  send(&p, "GPGGA,120002,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+  check("GGA with a fix", "A");
+  send(&p, "GPRMC,120002,A,4807.038,N,01131.000,E,022.4,084.4,010125,,");
+  send(&p, "GPGLL,4807.038,N,01131.000,E,120002,A");
+  check("still a fix", "");
+
+  send(&p, "GPRMC,120003,V,,,,,,,010125,,");
+  check("RMC lost the fix", "N");
+  send(&p, "GPGLL,4807.038,N,01131.000,E,120004,A");
+  check("GLL with a fix", "A");
+  send(&p, "GPGLL,,,,,120005,V");
+  check("GLL lost the fix", "N");
+}
+
+/*****************************************************************************/
+/* A sentence saying there is a fix only counts once it has decoded        */
+/*****************************************************************************/
+static void check_acquired_once_valid(void) {
+  gps_parser_t p;
+
+  init(&p, 0);
+  send(&p, "GPGGA,120000,,,,,0,00,,,M,,M,,");
+  check("no fix", "N");
+  send(&p, "GPGGA,120001,9107.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+  send(&p, "GPRMC,120001,A,4807.038,N,01131.000,E,022.4,084.4,321325,,");
+  check("sentences that did not decode", "");
+  send(&p, "GPRMC,120002,A,4807.038,N,01131.000,E,022.4,084.4,010125,,");
+  check("RMC with a fix", "A");
+}
+
+/*****************************************************************************/
+/* Losing the fix closes the epoch then, and VTG sent without a fix are not */
+/* merged into the epoch after                                              */
+/*****************************************************************************/
+static void check_epoch(void) {
+  gps_parser_t p;
+
+  init(&p, 1);
+  send(&p, "GPGGA,120000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+  send(&p, "GPRMC,120000,A,4807.038,N,01131.000,E,022.4,084.4,010125,,");
+  check("epoch open", "A");
+  send(&p, "GPGGA,120001,,,,,0,00,,,M,,M,,");
+  check("epoch closed by the loss", "NF");
+  check_value("closed epoch time", last_fix.time_ms, 43200000);
+  check_value("closed epoch has a position", (last_fix.have & GPS_FIX_POSITION) != 0, 1);
+
+  send(&p, "GPVTG,054.7,T,034.4,M,005.5,N,010.2,K");
+  send(&p, "GPGGA,120002,,,,,0,00,,,M,,M,,");
+  gps_parser_flush(&p);
+  check("nothing merged without a fix", "");
+
+  send(&p, "GPGGA,120003,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+  gps_parser_flush(&p);
+  check("fix back", "AF");
+  check_value("fix back has no velocity", (last_fix.have & GPS_FIX_VELOCITY) != 0, 0);
+}
+
+/*****************************************************************************/
+int main(void) {
+  check_changes();
+  check_acquired_once_valid();
+  check_epoch();
+
+  if(failures) return 1;
+  printf("fix state ok\n");
+  return 0;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,197 @@
+/******************************************************************************
+* geo.c - accuracy of the gps_geo conversions
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <math.h>
+#include "../gps_geo.h"
+
+/*****************************************************************************
+* Checks the error bounds given in gps_geo.h. The reference is the same
+* formulas in long double through libm, over random points and pairs of
+* points near each other, far apart and nearly opposite.
+*****************************************************************************/
+#define POINTS 100000
+
+static const long double deg = 3.14159265358979323846264338327950288L / 180;
+static double latitude[POINTS], longitude[POINTS], altitude[POINTS];
+static double x[POINTS], y[POINTS], z[POINTS];
+static int    failures;
+
+/*****************************************************************************/
+static unsigned long long seed = 88172645463325252ULL;
+
+static double uniform(double lo, double hi) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return lo + (hi - lo) * ((seed >> 11) * (1.0 / 9007199254740992.0));
+}
+
+/*****************************************************************************/
+static void ecef(long double lat, long double lon, long double alt, long double out[3]) {
+  long double sin_lat = sinl(lat * deg), cos_lat = cosl(lat * deg);
+  long double n = 6378137.0L / sqrtl(1 - 6.69437999014e-3L * sin_lat * sin_lat);
+
+  out[0] = (n + alt) * cos_lat * cosl(lon * deg);
+  out[1] = (n + alt) * cos_lat * sinl(lon * deg);
+  out[2] = (n * (1 - 6.69437999014e-3L) + alt) * sin_lat;
+}
+
+/*****************************************************************************/
+static long double haversine(long double lat1, long double lon1, long double lat2, long double lon2) {
+  long double s1 = sinl((lat2 - lat1) * deg / 2), s2 = sinl((lon2 - lon1) * deg / 2);
+  long double a  = s1 * s1 + cosl(lat1 * deg) * cosl(lat2 * deg) * s2 * s2;
+  return 2 * 6371008.8L * asinl(sqrtl(a > 1 ? 1 : a));
+}
+
+/*****************************************************************************/
+static void check(const char *what, const char *mode, double error, double bound) {
+  printf("%-28s %-8s %10.3g (bound %g)\n", what, mode, error, bound);
+  if(!(error <= bound)) {
+    printf("  ^ over the bound\n");
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+static void test_ecef(int mode, double bound) {
+  double worst = 0;
+  int    i, k;
+
+  for(i = 0; i < POINTS; i++) {
+    latitude[i]  = uniform(-90, 90);
+    longitude[i] = uniform(-180, 180);
+    altitude[i]  = uniform(-500, 10000);
+  }
+  gps_geo_ecef(latitude, longitude, altitude, POINTS, x, y, z, mode);
+  for(i = 0; i < POINTS; i++) {
+    long double ref[3];
+    double      got[3] = { x[i], y[i], z[i] };
+    ecef(latitude[i], longitude[i], altitude[i], ref);
+    for(k = 0; k < 3; k++)
+      worst = fmax(worst, fabs((double)(got[k] - ref[k])));
+  }
+  check("ECEF (m)", mode == GPS_GEO_FAST ? "fast" : "precise", worst, bound);
+}
+
+/*****************************************************************************/
+static void test_enu(int mode, double bound) {
+  const double ref_lat = 40, ref_lon = -75, ref_alt = 100;
+  long double  ref[3];
+  long double  sin_lat = sinl(ref_lat * deg), cos_lat = cosl(ref_lat * deg);
+  long double  sin_lon = sinl(ref_lon * deg), cos_lon = cosl(ref_lon * deg);
+  double       worst = 0;
+  int          i;
+
+  for(i = 0; i < POINTS; i++) {
+    latitude[i]  = ref_lat + uniform(-1, 1);
+    longitude[i] = ref_lon + uniform(-1, 1);
+    altitude[i]  = uniform(-500, 10000);
+  }
+  ecef(ref_lat, ref_lon, ref_alt, ref);
+  gps_geo_enu(latitude, longitude, altitude, POINTS, ref_lat, ref_lon, ref_alt, x, y, z, mode);
+  for(i = 0; i < POINTS; i++) {
+    long double p[3], dx, dy, dz, east, north, up;
+    ecef(latitude[i], longitude[i], altitude[i], p);
+    dx    = p[0] - ref[0];
+    dy    = p[1] - ref[1];
+    dz    = p[2] - ref[2];
+    east  = -sin_lon * dx + cos_lon * dy;
+    north = -sin_lat * cos_lon * dx - sin_lat * sin_lon * dy + cos_lat * dz;
+    up    =  cos_lat * cos_lon * dx + cos_lat * sin_lon * dy + sin_lat * dz;
+    worst = fmax(worst, fabs((double)(x[i] - east)));
+    worst = fmax(worst, fabs((double)(y[i] - north)));
+    worst = fmax(worst, fabs((double)(z[i] - up)));
+  }
+  check("ENU within 100km (m)", mode == GPS_GEO_FAST ? "fast" : "precise", worst, bound);
+}
+
+/*****************************************************************************/
+/* Pairs of points, each pair's distance checked. Kind 0 is anywhere, 1 is  */
+/* within a kilometre or so, 2 within about 10km of the antipode, half of   */
+/* them exactly on it                                                       */
+/*****************************************************************************/
+static void test_distance(int kind, int mode, double abs_bound, double rel_bound) {
+  static const char *what[] = { "distance", "distance <1.5km", "distance near antipode" };
+  const char *name = mode == GPS_GEO_FAST ? "fast" : "precise";
+  double worst_abs = 0, worst_rel = 0;
+  char   label[64];
+  int    i;
+
+  for(i = 0; i < POINTS; i += 2) {
+    latitude[i]  = uniform(-89.9, 89.9);
+    longitude[i] = uniform(-180, 180);
+    if(kind == 0) {
+      latitude[i+1]  = uniform(-90, 90);
+      longitude[i+1] = uniform(-180, 180);
+    } else if(kind == 1) {
+      latitude[i+1]  = latitude[i]  + uniform(-0.01, 0.01);
+      longitude[i+1] = longitude[i] + uniform(-0.01, 0.01);
+    } else if(i % 4 == 0) {
+      latitude[i+1]  = -latitude[i] + uniform(-0.1, 0.1);
+      longitude[i+1] = longitude[i] + 180 + uniform(-0.1, 0.1);
+    } else {
+      latitude[i+1]  = -latitude[i];
+      longitude[i+1] = longitude[i] + 180;
+    }
+  }
+  gps_geo_distance(latitude, longitude, POINTS, x, mode);
+  for(i = 0; i < POINTS; i += 2) {
+    long double ref = haversine(latitude[i], longitude[i], latitude[i+1], longitude[i+1]);
+    double      err = fabs((double)(x[i] - ref));
+    worst_abs = fmax(worst_abs, err);
+    if(ref > 0)
+      worst_rel = fmax(worst_rel, err / (double)ref);
+  }
+  if(abs_bound > 0) {
+    snprintf(label, sizeof(label), "%s (m)", what[kind]);
+    check(label, name, worst_abs, abs_bound);
+  }
+  if(rel_bound > 0) {
+    snprintf(label, sizeof(label), "%s (rel)", what[kind]);
+    check(label, name, worst_rel, rel_bound);
+  }
+}
+
+/*****************************************************************************/
+int main(void) {
+  test_ecef(GPS_GEO_PRECISE, 1e-8);
+  test_ecef(GPS_GEO_FAST,    1e-4);
+  test_enu(GPS_GEO_PRECISE,  1e-8);
+  test_enu(GPS_GEO_FAST,     1e-5);
+  test_distance(0, GPS_GEO_PRECISE, 0,    1e-13);
+  test_distance(0, GPS_GEO_FAST,    0.01, 1e-9);
+  test_distance(1, GPS_GEO_PRECISE, 0,    1e-13);
+  test_distance(1, GPS_GEO_FAST,    0,    1e-9);
+  test_distance(2, GPS_GEO_PRECISE, 0.25, 0);
+  test_distance(2, GPS_GEO_FAST,    50,   0);
+
+  return failures != 0;
+}
+/************************ End of file  ***************************************/
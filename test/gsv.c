@@ -0,0 +1,173 @@
+/******************************************************************************
+* gsv.c - satellites in view collected from GSV sequences
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "../gps_parse.h"
+
+/*****************************************************************************
+* GSV sequences, whole, broken off and mixed up, are fed to a parser and the
+* satellite tables the callback gets are checked.
+*****************************************************************************/
+static int       failures;
+static int       skies;
+static gps_sky_t last_sky;
+
+static void on_GSV(void *user, const gps_sky_t *sky) { last_sky = *sky; skies++; }
+
+/*****************************************************************************/
+static void send(gps_parser_t *p, const char *body) {
+  char          line[128];
+  unsigned char checksum = 0;
+  const char   *c;
+
+  for(c = body; *c; c++)
+    checksum ^= (unsigned char)*c;
+  snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+  gps_parser_add_bytes(p, line, strlen(line));
+}
+
+/*****************************************************************************/
+static void check(const char *what, long got, long expect) {
+  if(got != expect) {
+    printf("%s: %ld, not %ld\n", what, got, expect);
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+static void init(gps_parser_t *p) {
+  gps_parser_init(p, NULL);
+  gps_parser_GSV_callback_set(p, on_GSV);
+  gps_parser_add_char(p, '\n');
+  skies = 0;
+  memset(&last_sky, 0, sizeof(last_sky));
+}
+
+/*****************************************************************************/
+/* A whole sequence gives one callback with every satellite in it           */
+/*****************************************************************************/
+static void check_whole(void) {
+  gps_parser_t p;
+
+  init(&p);
+  send(&p, "GPGSV,3,1,10,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+  send(&p, "GPGSV,3,2,10,15,62,109,,17,08,041,33,19,30,172,40,22,11,260,38");
+  check("callbacks before the last part", skies, 0);
+  send(&p, "GPGSV,3,3,10,24,55,056,47,32,,,");
+  check("callbacks", skies, 1);
+  check("talker", strcmp(last_sky.talker, "GP"), 0);
+  check("sats_in_view", last_sky.sats_in_view, 10);
+  check("count", last_sky.count, 10);
+  check("first prn", last_sky.sat[0].prn, 1);
+  check("first elevation", last_sky.sat[0].elevation, 40);
+  check("first azimuth", last_sky.sat[0].azimuth, 83);
+  check("first snr", last_sky.sat[0].snr, 46);
+  check("untracked snr", last_sky.sat[4].snr, -1);
+  check("last prn", last_sky.sat[9].prn, 32);
+  check("last elevation", last_sky.sat[9].elevation, -1);
+  check("last azimuth", last_sky.sat[9].azimuth, -1);
+
+  /* One part, with nothing in view */
+  send(&p, "GLGSV,1,1,00");
+  check("empty sky callbacks", skies, 2);
+  check("empty sky talker", strcmp(last_sky.talker, "GL"), 0);
+  check("empty sky count", last_sky.count, 0);
+
+  /* NMEA 4.1 signal ID after the satellites */
+  send(&p, "GAGSV,1,1,04,02,40,083,46,08,17,308,41,12,07,344,39,30,22,228,45,7");
+  check("signal id callbacks", skies, 3);
+  check("signal id count", last_sky.count, 4);
+  check("signal id last snr", last_sky.sat[3].snr, 45);
+}
+
+/*****************************************************************************/
+/* Sequences that break off, or get mixed up with another, are dropped      */
+/* until the next one starts                                                */
+/*****************************************************************************/
+static void check_broken(void) {
+  gps_parser_t p;
+
+  init(&p);
+  send(&p, "GPGSV,3,1,10,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+  send(&p, "GPGSV,3,3,10,24,55,056,47,32,,,");
+  check("missing part", skies, 0);
+
+  send(&p, "GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+  send(&p, "GLGSV,2,2,08,65,62,109,,66,08,041,33,72,30,172,40,73,11,260,38");
+  send(&p, "GPGSV,2,2,08,15,62,109,,17,08,041,33,19,30,172,40,22,11,260,38");
+  check("other talker", skies, 0);
+
+  send(&p, "GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+  send(&p, "GPGSV,3,2,08,15,62,109,,17,08,041,33,19,30,172,40,22,11,260,38");
+  check("other total", skies, 0);
+
+  send(&p, "GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+  send(&p, "GPGSV,2,2,08,15,xx,109,,17,08,041,33,19,30,172,40,22,11,260,38");
+  check("bad part", skies, 0);
+
+  /* The next whole sequence starts afresh */
+  send(&p, "GPGSV,2,1,08,03,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+  send(&p, "GPGSV,2,2,08,15,62,109,,17,08,041,33,19,30,172,40,22,11,260,38");
+  check("next whole sequence", skies, 1);
+  check("next whole count", last_sky.count, 8);
+  check("next whole first prn", last_sky.sat[0].prn, 3);
+}
+
+/*****************************************************************************/
+/* No more than GPS_MAX_SATS are kept, though sats_in_view says more        */
+/*****************************************************************************/
+static void check_full(void) {
+  gps_parser_t p;
+  char         body[128];
+  int          part;
+
+  init(&p);
+  for(part = 1; part <= 10; part++) {
+    snprintf(body, sizeof(body), "GPGSV,10,%d,40,%02d,10,100,30,%02d,10,100,30,%02d,10,100,30,%02d,10,100,30",
+             part, part*4-3, part*4-2, part*4-1, part*4);
+    send(&p, body);
+  }
+  check("full callbacks", skies, 1);
+  check("full sats_in_view", last_sky.sats_in_view, 40);
+  check("full count", last_sky.count, GPS_MAX_SATS);
+  check("full last prn", last_sky.sat[GPS_MAX_SATS-1].prn, GPS_MAX_SATS);
+}
+
+/*****************************************************************************/
+int main(void) {
+  check_whole();
+  check_broken();
+  check_full();
+
+  if(failures) return 1;
+  printf("GSV sequences ok\n");
+  return 0;
+}
+/************************ End of file  ***************************************/
@@ -0,0 +1,201 @@
+/******************************************************************************
+* merge.c - fixes from several receivers merged in time order
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "../gps_merge.h"
+
+/*****************************************************************************
+* Fixes are added to a merge by hand and what comes out, and from which
+* source, is checked against what should.
+*****************************************************************************/
+#define MAX_OUT 32
+
+static int      failures;
+static unsigned out_ms[MAX_OUT];
+static unsigned out_source[MAX_OUT];
+static unsigned outs;
+
+static void on_fix(void *user, const gps_fix_t *fix) {
+  gps_merge_t *m = user;
+  if(outs < MAX_OUT) {
+    out_ms[outs]     = fix->time_ms;
+    out_source[outs] = m->out_source;
+  }
+  outs++;
+}
+
+/*****************************************************************************/
+static void check(const char *what, long got, long expect) {
+  if(got != expect) {
+    printf("%s: %ld, not %ld\n", what, got, expect);
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+static void init(gps_merge_t *m, unsigned sources, unsigned window_ms) {
+  gps_merge_init(m, sources, window_ms, on_fix, m);
+  outs = 0;
+}
+
+/*****************************************************************************/
+static void add(gps_merge_t *m, unsigned source, unsigned time_ms,
+                unsigned quality, unsigned sats, double hor_dop) {
+  gps_fix_t fix;
+
+  memset(&fix, 0, sizeof(fix));
+  fix.have        = GPS_FIX_TIME;
+  fix.time_ms     = time_ms;
+  if(quality > 0) {
+    fix.have       |= GPS_FIX_POSITION | GPS_FIX_QUALITY;
+    fix.fix_quality = quality;
+    fix.no_of_sats  = sats;
+    fix.hor_dop     = hor_dop;
+  }
+  gps_merge_add(m, source, &fix);
+}
+
+/*****************************************************************************/
+static void check_init(void) {
+  gps_merge_t m;
+
+  check("init with no sources", gps_merge_init(&m, 0, 1000, on_fix, &m), 0);
+  check("init with too many sources",
+        gps_merge_init(&m, GPS_MERGE_MAX_SOURCES+1, 1000, on_fix, &m), 0);
+  check("init", gps_merge_init(&m, GPS_MERGE_MAX_SOURCES, 1000, on_fix, &m), 1);
+}
+
+/*****************************************************************************/
+/* Fixes arriving out of order come out in order, once each                 */
+/*****************************************************************************/
+static void check_order(void) {
+  gps_merge_t m;
+
+  init(&m, 2, 1000);
+  add(&m, 0, 2000, 1, 8, 1.0);
+  add(&m, 1, 1000, 1, 8, 1.0);
+  check("fixes held for the other source", outs, 0);
+  add(&m, 1, 2000, 1, 8, 1.0);
+  check("fixes out", outs, 2);
+  check("first fix", out_ms[0], 1000);
+  check("second fix", out_ms[1], 2000);
+
+  add(&m, 0, 1000, 1, 8, 1.0);
+  check("late fix dropped", outs, 2);
+  check("late", m.late, 1);
+
+  /* Across midnight 00:00:00 follows 23:59:59 */
+  init(&m, 2, 1000);
+  add(&m, 0, 0, 1, 8, 1.0);
+  add(&m, 1, 86399500, 1, 8, 1.0);
+  add(&m, 1, 0, 1, 8, 1.0);
+  check("fixes out across midnight", outs, 2);
+  check("before midnight", out_ms[0], 86399500);
+  check("after midnight", out_ms[1], 0);
+}
+
+/*****************************************************************************/
+/* The best fix for each time is passed on whole                            */
+/*****************************************************************************/
+static void check_best(void) {
+  gps_merge_t m;
+
+  /* RTK fixed over more satellites */
+  init(&m, 2, 1000);
+  add(&m, 0, 1000, 1, 12, 0.8);
+  add(&m, 1, 1000, 4,  6, 1.5);
+  check("RTK fixed chosen", out_source[0], 1);
+
+  /* A position over none */
+  init(&m, 2, 1000);
+  add(&m, 0, 1000, 0, 0, 0);
+  add(&m, 1, 1000, 1, 4, 2.0);
+  check("position chosen", out_source[0], 1);
+
+  /* More satellites, then the lower hor_dop, where 0 is none sent */
+  init(&m, 3, 1000);
+  add(&m, 0, 1000, 2, 7, 0.9);
+  add(&m, 1, 1000, 2, 9, 1.2);
+  add(&m, 2, 1000, 2, 8, 0.7);
+  check("more satellites chosen", out_source[0], 1);
+  add(&m, 0, 2000, 1, 8, 0);
+  add(&m, 1, 2000, 1, 8, 1.4);
+  add(&m, 2, 2000, 1, 8, 0.9);
+  check("lower hor_dop chosen", out_source[1], 2);
+  check("source 2 chosen", m.source[2].chosen, 1);
+  check("source 0 fixes", m.source[0].fixes, 2);
+}
+
+/*****************************************************************************/
+/* A silent source holds things up for at most the window, and a full set   */
+/* of slots passes on the oldest                                            */
+/*****************************************************************************/
+static void check_window(void) {
+  gps_merge_t m;
+  gps_fix_t   fix;
+  unsigned    i;
+
+  init(&m, 2, 1000);
+  add(&m, 0, 1000, 1, 8, 1.0);
+  add(&m, 0, 2000, 1, 8, 1.0);
+  check("within the window", outs, 0);
+  add(&m, 0, 2500, 1, 8, 1.0);
+  check("past the window", outs, 1);
+  check("past the window fix", out_ms[0], 1000);
+  gps_merge_flush(&m);
+  check("flushed", outs, 3);
+  check("last flushed", out_ms[2], 2500);
+
+  init(&m, 2, 60000);
+  for(i = 0; i <= GPS_MERGE_SLOTS; i++)
+    add(&m, 0, 1000 + i*100, 1, 8, 1.0);
+  check("overflow", m.overflow, 1);
+  check("passed on early", outs, 1);
+  check("oldest passed on", out_ms[0], 1000);
+
+  init(&m, 2, 1000);
+  memset(&fix, 0, sizeof(fix));
+  gps_merge_add(&m, 1, &fix);
+  check("untimed", m.untimed, 1);
+  check("untimed held", m.count, 0);
+}
+
+/*****************************************************************************/
+int main(void) {
+  check_init();
+  check_order();
+  check_best();
+  check_window();
+
+  if(failures) return 1;
+  printf("merge ok\n");
+  return 0;
+}
+/************************ End of file  ***************************************/
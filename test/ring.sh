@@ -0,0 +1,20 @@
+#!/bin/sh
+###############################################################################
+# ring.sh - example/ring must get the same fixes through the byte ring and
+# fix queue, from a pipe and from a pseudo-terminal, as decoding directly
+###############################################################################
+set -e
+cd "$(dirname "$0")/.."
+log=test/ring.nmea
+trap 'rm -f $log' EXIT
+
+for gen in "-S 1" "-S 2 -F 0.3" "-S 3 -e 0.02" "-S 4 -G 0.1"; do
+  ./bench/bench -g -n 4000000 $gen > $log
+  for mode in "" -p; do
+    if ! out=$(./example/ring $mode $log); then
+      echo "$out (bench -g $gen)"
+      exit 1
+    fi
+  done
+done
+echo "ring output is the same from a pipe and a pty"
@@ -0,0 +1,183 @@
+/******************************************************************************
+* utc.c - UTC times: dates, midnight and GPS week rollovers
+*
+* Author: Mike Field - <hamster@snap.net.nz>
+* 
+*
+******************************************************************************
+* MIT License
+*
+* Copyright (c) 2018 Mike Field
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "../gps_parse.h"
+
+/*****************************************************************************
+* Sentences are fed to a parser and the utc_ns and rx_ns they come out with
+* are checked against days since 1970 worked out independently.
+*****************************************************************************/
+#define DAY_NS   86400000000000LL
+#define MS_NS    1000000LL
+
+static int       failures;
+static gps_GGA_t last_gga;
+static gps_fix_t last_fix;
+static int       fixes;
+
+static void on_GGA(void *user, const gps_GGA_t *gga) { last_gga = *gga; }
+static void on_fix(void *user, const gps_fix_t *fix) { last_fix = *fix; fixes++; }
+
+/*****************************************************************************/
+static void send(gps_parser_t *p, const char *body, int64_t rx_ns) {
+  char          line[128];
+  unsigned char checksum = 0;
+  const char   *c;
+
+  for(c = body; *c; c++)
+    checksum ^= (unsigned char)*c;
+  snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+  gps_parser_add_bytes_at(p, line, strlen(line), rx_ns);
+}
+
+/*****************************************************************************/
+static void check(const char *what, int64_t got, int64_t expect) {
+  if(got != expect) {
+    printf("%s: %lld, not %lld\n", what, (long long)got, (long long)expect);
+    failures++;
+  }
+}
+
+/*****************************************************************************/
+static void init(gps_parser_t *p) {
+  gps_parser_init(p, NULL);
+  gps_parser_GGA_callback_set(p, on_GGA);
+  gps_parser_fix_callback_set(p, on_fix);
+  gps_parser_add_char(p, '\n');
+}
+
+/*****************************************************************************/
+static void check_days(void) {
+  check("1970-01-01", gps_utc_days(1970,  1,  1),       0);
+  check("1969-12-31", gps_utc_days(1969, 12, 31),      -1);
+  check("1980-01-06", gps_utc_days(1980,  1,  6),    3657);
+  check("2000-03-01", gps_utc_days(2000,  3,  1),   11017);
+  check("2024-02-29", gps_utc_days(2024,  2, 29),   19782);
+  check("2024-12-31", gps_utc_days(2024, 12, 31),   20088);
+  check("2100-03-01", gps_utc_days(2100,  3,  1),   47541);
+  check("1600-03-01", gps_utc_days(1600,  3,  1), -135080);
+}
+
+/*****************************************************************************/
+/* The day moves on when the time goes back past midnight, and a sentence   */
+/* from just before midnight arriving late stays on the day before          */
+/*****************************************************************************/
+static void check_midnight(void) {
+  gps_parser_t p;
+  int64_t      dec31 = 20088 * DAY_NS;
+
+  init(&p);
+  send(&p, "GPGGA,235959.500,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("utc_ns before any date", last_gga.utc_ns, 0);
+
+  send(&p, "GPRMC,235959.500,A,4807.038,N,01131.000,E,022.4,084.4,311224,,", 0);
+  send(&p, "GPGGA,235959.750,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("utc_ns on the day of the RMC", last_gga.utc_ns, dec31 + 86399750 * MS_NS);
+
+  send(&p, "GPGGA,000000.250,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("utc_ns after midnight", last_gga.utc_ns, dec31 + DAY_NS + 250 * MS_NS);
+
+  send(&p, "GPGGA,235959.900,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("utc_ns of a late sentence", last_gga.utc_ns, dec31 + 86399900 * MS_NS);
+
+  send(&p, "GPGGA,120000.000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("utc_ns at noon after", last_gga.utc_ns, dec31 + DAY_NS + 43200000 * MS_NS);
+
+  /* Another midnight, with no date in between */
+  send(&p, "GPGGA,230000.000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  send(&p, "GPGGA,000001.000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("utc_ns two midnights on", last_gga.utc_ns, dec31 + 2 * DAY_NS + 1000 * MS_NS);
+
+  /* More than half a day ahead is from the day before */
+  send(&p, "GPGGA,130000.000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("utc_ns half a day ahead", last_gga.utc_ns, dec31 + DAY_NS + 46800000 * MS_NS);
+}
+
+/*****************************************************************************/
+/* Two digit years are 1980 to 2079, and dates before the earliest allowed  */
+/* move on by whole 1024 week rollovers                                     */
+/*****************************************************************************/
+static void check_rollover(void) {
+  gps_parser_t p;
+
+  init(&p);
+  send(&p, "GPRMC,000000,A,4807.038,N,01131.000,E,022.4,084.4,161000,,", 0);
+  send(&p, "GPGGA,000000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("2000-10-16 after one rollover", last_gga.utc_ns, 18414 * DAY_NS);
+
+  init(&p);
+  gps_parser_earliest_utc_set(&p, 1546300800);          /* 2019-01-01 */
+  send(&p, "GPRMC,000000,A,4807.038,N,01131.000,E,022.4,084.4,210899,,", 0);
+  send(&p, "GPGGA,000000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("1999-08-21 after one rollover", last_gga.utc_ns, 17992 * DAY_NS);
+
+  init(&p);
+  gps_parser_earliest_utc_set(&p, 0);
+  send(&p, "GPRMC,000000,A,4807.038,N,01131.000,E,022.4,084.4,010180,,", 0);
+  send(&p, "GPGGA,000000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("year 80", last_gga.utc_ns, 3652 * DAY_NS);
+  send(&p, "GPRMC,000000,A,4807.038,N,01131.000,E,022.4,084.4,311279,,", 0);
+  send(&p, "GPGGA,000000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 0);
+  check("year 79", last_gga.utc_ns, 40176 * DAY_NS);
+}
+
+/*****************************************************************************/
+/* A fix has the utc_ns of its epoch and the rx_ns of its first sentence    */
+/*****************************************************************************/
+static void check_fix(void) {
+  gps_parser_t p;
+
+  init(&p);
+  fixes = 0;
+  send(&p, "GPRMC,235959.500,A,4807.038,N,01131.000,E,022.4,084.4,311224,,", 1000);
+  send(&p, "GPGGA,235959.500,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 2000);
+  send(&p, "GPGGA,000000.500,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", 3000);
+  check("fixes", fixes, 1);
+  check("fix utc_ns", last_fix.utc_ns, 20088 * DAY_NS + 86399500 * MS_NS);
+  check("fix rx_ns", last_fix.rx_ns, 1000);
+  check("fix has UTC", (last_fix.have & GPS_FIX_UTC) != 0, 1);
+  gps_parser_flush(&p);
+  check("next fix utc_ns", last_fix.utc_ns, 20089 * DAY_NS + 500 * MS_NS);
+  check("next fix rx_ns", last_fix.rx_ns, 3000);
+}
+
+/*****************************************************************************/
+int main(void) {
+  check_days();
+  check_midnight();
+  check_rollover();
+  check_fix();
+
+  if(failures) return 1;
+  printf("UTC times ok\n");
+  return 0;
+}
+/************************ End of file  ***************************************/